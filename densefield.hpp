@@ -15,7 +15,7 @@
  * - A bracket operator for coordinates is implemented, with adjustable behavior for non-existing coords.
  * - The performance of exists() relies on STL's map::lower_bound O(log) complexity
  * - The center coordinate (1) always exists
- * - boundary conditions can be implemented as lambdas
+ * - Dirichlet, Neumann and reflecting boundary conditions built in, others can be implemented as lambdas
  *
  */
 
@@ -38,6 +38,18 @@ public:
     	createEntireLevel(level);
     }
 
+    // Takes the structure of the first DenseField operand of a field expression, not its values, and evaluates the
+    // expression into it, see field.hpp. Expressions without an operand that can be a DenseField don't compile.
+    template <typename E, typename = typename enable_if<is_base_of<FieldExprNode, E>::value>::type>
+    DenseField(const E& expr) : DenseField(Field<DTYPE, HCSTYPE>::template structureOf<DenseField>(expr).hcs) {
+        static_assert(FieldExprHasStructure<DenseField, E>::value, "The expression has no DenseField operand to take the structure from");
+        const DenseField& f = Field<DTYPE, HCSTYPE>::template structureOf<DenseField>(expr);
+        takeStructure(const_cast<DenseField&>(f));
+        this->bracket_behavior = f.bracket_behavior;
+        this->copyBoundary(f);
+        *this = expr;
+    }
+
 
     // The copy constructor, to make quick copies of the field and its structure
     // Field<??> a = b; Or Field<??> a(b);
@@ -49,9 +61,8 @@ public:
         hcs = this->hcs;
         this->bracket_behavior = f.bracket_behavior;
         this->data = f.data;
-        this->boundary_propagate = f.boundary_propagate;
-        for (int i = 0; i < 64; i++)
-            this->boundary[i] = this->boundary_propagate[i] ? f.boundary[i] : nullptr;
+        this->dirty = f.dirty;
+        this->copyBoundary(f);
     }
 
     ~DenseField() {}
@@ -72,6 +83,9 @@ private:
     level_t max_level;
     coord_t max_coord;
 
+    // One bit per index of data for markDirty(), empty while nothing is marked
+    vector<uint64_t> dirty;
+
 public:
     HCSTYPE hcs;
 
@@ -81,21 +95,18 @@ public:
         DenseIterator(DenseField<DTYPE, HCSTYPE>* field, bool top_only = false, int only_level = -1) : current(1), field(field), only_level(only_level), top_only(top_only), end_coord(1), current_pair(0, intermediate), current_idx(0) {
             if (field == NULL)
                 return;
-            hcs = field->hcs;
-            if (top_only && only_level >= 0)
-                throw range_error("Field iterator can only be top_only or only_level, not both.");
-            this->at_end = (only_level > field->max_level);
+            this->at_end = only_level > field->max_level || (top_only && only_level >= 0 && only_level != field->max_level);
             if (this->at_end)
                 return;
-            end_coord = hcs.CreateMaxLevel(field->max_level);
+            end_coord = HCSTYPE::CreateMaxLevel(field->max_level);
             if (only_level >= 0) {
-                current = hcs.CreateMinLevel(only_level);
-                end_coord = hcs.CreateMaxLevel(only_level);
+                current = HCSTYPE::CreateMinLevel(only_level);
+                end_coord = HCSTYPE::CreateMaxLevel(only_level);
             } else if (top_only)
-                current = hcs.CreateMinLevel(field->max_level);
+                current = HCSTYPE::CreateMinLevel(field->max_level);
             else
                 current = 1;
-            current_idx = hcs.coord2index(current);
+            current_idx = HCSTYPE::coord2index(current);
             this->currentCoord = current;
             this->currentValPtr = &field->data[current_idx];
 
@@ -111,7 +122,7 @@ public:
         }
 
         virtual void increment() {
-            if (hcs.inc(current))
+            if (HCSTYPE::inc(current))
                 this->at_end = current > end_coord;
             current_idx++;
             this->currentCoord = current;
@@ -134,7 +145,6 @@ public:
         size_t current_idx;
         int only_level;
         bool top_only;
-        HCSTYPE hcs;
     };
 
     // Iterator methods & class
@@ -147,6 +157,49 @@ public:
         return NULL;
     }
 
+    // Calls fn(coord, value&) for the same coords as begin(top_only, only_level) in the same order, without
+    // the virtual iterator. Each level is a contiguous run in data.
+    template <typename FN>
+    void for_each(bool top_only, int only_level, FN fn) {
+        if (data.empty() || only_level > max_level || (top_only && only_level >= 0 && only_level != max_level))
+            return;
+        int lo = only_level >= 0 ? only_level : (top_only ? max_level : 0);
+        int hi = only_level >= 0 ? only_level : max_level;
+        for (int level = lo; level <= hi; level++) {
+            coord_t c = HCSTYPE::CreateMinLevel(level);
+            coord_t c_end = HCSTYPE::CreateMaxLevel(level);
+            DTYPE* value = &data[HCSTYPE::coord2index(c)];
+            for (; c <= c_end; c++, value++)
+                fn(c, *value);
+        }
+    }
+
+    template <typename FN>
+    void for_each(FN fn) {
+        for_each(false, -1, fn);
+    }
+
+    // Field::levels(), one span per level
+    vector<FieldSpan<DTYPE> > levels(int lo = 0, int hi = -1, bool descending = false) {
+        vector<FieldSpan<DTYPE> > result;
+        if (data.empty())
+            return result;
+        hi = hi < 0 ? max_level : min<int>(hi, max_level);
+        for (int level = max(lo, 0); level <= hi; level++) {
+            FieldSpan<DTYPE> span;
+            span.level = level;
+            span.start = HCSTYPE::CreateMinLevel(level);
+            span.end = HCSTYPE::CreateMaxLevel(level);
+            span.values = &data[HCSTYPE::coord2index(span.start)];
+            span.top = NULL;
+            span.all_top = level == max_level;
+            result.push_back(span);
+        }
+        if (descending)
+            reverse(result.begin(), result.end());
+        return result;
+    }
+
 
     // Returns the number of available elements for this field
     size_t nElements() {
@@ -181,12 +234,12 @@ public:
         return data[hcs.coord2index(coord)];
     }
 
-    bool exists(coord_t coord) {
+    bool exists(coord_t coord) final {
         return coord <= max_coord;
     }
 
     // Does not query coefficients, throws if coord does not exist
-    DTYPE& getDirect(coord_t coord) {
+    DTYPE& getDirect(coord_t coord) final {
         //if (!this->exists(coord))
         //   throw range_error("[]: Coord does not exist");
         return data[hcs.coord2index(coord)];
@@ -195,14 +248,24 @@ public:
     // Returns value for coord, if not present, interpolates.
     // if it is not TLC, return value anyway. To retrieve proper values from non-TLC
     // call propagate() first
-    DTYPE get(coord_t coord, bool use_non_top = true) {
+    DTYPE get(coord_t coord, bool use_non_top = true) final {
         DTYPE result = 0;
-        Field<DTYPE, HCSTYPE>::get(coord, result, use_non_top);
+        this->getT(this, coord, result, use_non_top);
         return result;
     }
 
+    // Field::getMany() with the lookups of this class inlined
+    void getMany(const coord_t* coords, size_t n, DTYPE* results, bool use_non_top = true) {
+        this->getManyT(this, coords, n, results, use_non_top);
+    }
+
+    // Field::getCoeffs() with exists() and isTop() of this class inlined
+    void getCoeffs(const coord_t coord, typename Field<DTYPE, HCSTYPE>::coeff_map_t &coeffs, bool use_non_top = true, int recursion = 0) {
+        this->getCoeffsT(this, coord, coeffs, use_non_top, recursion);
+    }
+
     // Do coordinates exist in a higher level?
-    bool isTop(coord_t coord) {
+    bool isTop(coord_t coord) final {
         return hcs.GetLevel(coord) == max_level;
     }
 
@@ -212,10 +275,9 @@ public:
 
         uint32_t parts = hcs.parts;
         data_t inv_parts = 1. / data_t(parts);
-        size_t idx = data.size() - 1;
-        coord_t c = hcs.index2coord(idx);
+        coord_t c = hcs.index2coord(data.size() - 1);
         c -= c % parts;
-        idx -= idx % parts;
+        size_t idx = hcs.coord2index(c);	// levels do not start at multiples of parts in the index
 
         while (c > parts) {
             DTYPE sum = 0;
@@ -226,6 +288,45 @@ public:
             hcs.decParts(c);
             idx -= parts;
         }
+        dirty.clear();
+    }
+
+    // Throws if coord does not exist
+    void markDirty(coord_t coord) {
+        if (!exists(coord))
+            throw range_error("markDirty: Coord does not exist");
+        if (dirty.empty())
+            dirty.resize((data.size() + 63) / 64, 0);
+        size_t idx = hcs.coord2index(coord);
+        dirty[idx / 64] |= uint64_t(1) << (idx % 64);
+    }
+
+    // The bitmap is walked from the highest index down, so all children of a level are done before their parents,
+    // which are marked in turn. Averages like propagate().
+    void propagateDirty() {
+        uint32_t parts = hcs.parts;
+        data_t inv_parts = 1. / data_t(parts);
+        for (size_t w = dirty.size(); w-- > 0;) {
+            while (dirty[w]) {
+                size_t idx = w * 64 + 63 - __builtin_clzll(dirty[w]);
+                dirty[w] &= ~(uint64_t(1) << (idx % 64));
+                coord_t c = hcs.index2coord(idx);
+                c -= c % parts;
+                if (c < parts)  // the center
+                    continue;
+                idx = hcs.coord2index(c);
+                for (size_t j = idx; j < idx + parts; j++)  // the siblings are done with it
+                    dirty[j / 64] &= ~(uint64_t(1) << (j % 64));
+                DTYPE sum = 0;
+                for (size_t j = idx; j < idx + parts; j++)
+                    sum += data[j];
+                sum *= inv_parts;
+                size_t parent = hcs.coord2index(hcs.ReduceLevel(c));
+                data[parent] = sum;
+                dirty[parent / 64] |= uint64_t(1) << (parent % 64);
+            }
+        }
+        dirty.clear();
     }
 
 
@@ -238,6 +339,7 @@ public:
         size_t level_end_idx = hcs.coord2index(max_coord);
 
         data.resize(level_end_idx + 1, DTYPE(0));
+        dirty.clear();
     }
 
     // Return highest stored coord-level. Could be faster.
@@ -254,10 +356,9 @@ public:
                 data.size() == f.data.size()));
 
         data = f.data;
+        dirty = f.dirty;
 
-        this->boundary_propagate = f.boundary_propagate;
-        for (int i = 0; i < 64; i++)
-            this->boundary[i] = this->boundary_propagate[i] ? f.boundary[i] : nullptr;
+        this->copyBoundary(f);
         return *this;
     };
 
@@ -269,12 +370,96 @@ public:
     };
 
     DenseField &operator=(const DTYPE& f){
-        fill(data.begin(), data.end(), f);
+        parallelRange(0, true, [&](size_t first, size_t last) { fill(data.begin() + first, data.begin() + last, f); });
         //Field<DTYPE,HCSTYPE>::operator =(f);
         return *this;
     }
 
-    DenseField<DTYPE, HCSTYPE> operator-() const { DenseField<DTYPE, HCSTYPE> result = *this; for (auto e : result) e.second = -e.second; return result;}
+    // Lazy arithmetic, see the end of field.hpp: a = b + 2. * c; evaluates in one pass, without temporary fields
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, DenseField&>::type operator=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v = x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator+=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v += x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator-=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v -= x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator*=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v *= x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator/=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v /= x; });
+        return *this;
+    }
+
+    // No caches, any number of threads can read
+    bool concurrentReads() final {
+        return true;
+    }
+
+    // Field::Accessor with the lookups of this class inlined
+    typedef FieldAccessor<DenseField> Accessor;
+
+    // Values of a level are stored consecutively, all coords above max_coord are missing
+    DTYPE* contiguousAt(coord_t coord, coord_t& run_end) final {
+        if (coord > max_coord)
+            return NULL;
+        run_end = min(run_end, HCSTYPE::CreateMaxLevel(hcs.GetLevel(coord)));
+        return &data[hcs.coord2index(coord)];
+    }
+
+private:
+    // Calls fn(first, last) for pieces of the indices begin .. data.size() - 1, one per thread if parallel
+    template <typename FN>
+    void parallelRange(size_t begin, bool parallel, FN fn) {
+        size_t n = data.size() - begin;
+        ParallelFor(n, parallel ? parallel_min_chunk : numeric_limits<size_t>::max(), [&](size_t first, size_t last) {
+            fn(begin + first, begin + last);
+        });
+    }
+
+    // Applies op(value, expr at coord) to all coords, the pieces of the threads are split at the levels
+    template <typename E, typename OP>
+    void evaluate(const E& expr, OP op) {
+        parallelRange(0, expr.concurrent(), [&](size_t first, size_t last) {
+            E e = expr;
+            while (first < last) {
+                coord_t start = HCSTYPE::index2coord(first);
+                coord_t end = min<coord_t>(HCSTYPE::CreateMaxLevel(hcs.GetLevel(start)), start + (last - first - 1));
+                Field<DTYPE, HCSTYPE>::evaluateRun(e, start, end, &data[first], op);
+                first += end - start + 1;
+            }
+        });
+    }
+
+    // fn(coord, value&) for the top level, one piece per thread if parallel
+    template <typename FN>
+    void forTop(bool parallel, FN fn) {
+        if (data.empty())
+            return;
+        parallelRange(HCSTYPE::coord2index(HCSTYPE::CreateMinLevel(max_level)), parallel, [&](size_t first, size_t last) {
+            coord_t c = HCSTYPE::index2coord(first);
+            for (size_t i = first; i < last; i++, c++)
+                fn(c, data[i]);
+        });
+    }
+
+public:
+
 
     // Clears the field and takes the same coordinate structure as the provided field, without copying their
     // values. The provided field may have a different DTYPE. The newly created coords are initialized with zero.
@@ -285,6 +470,7 @@ public:
         data.resize(f.data.size(), DTYPE(0));
         max_level = f.max_level;
         max_coord = f.max_coord;
+        dirty.clear();
     }
 
     // Tests if the provided field has the same structure.
@@ -297,6 +483,7 @@ public:
     // Empties all data
     void clear() {
         data.clear();
+        dirty.clear();
         //data.resize(2, DTYPE(0));
         max_level = 0;
         max_coord = 0;
@@ -304,155 +491,111 @@ public:
 
     Field<DTYPE, HCSTYPE>& operator*= (const DenseField<DTYPE, HCSTYPE>& rhs) {
         if (sameStructure(rhs)) {
-            for (size_t i = 0; i < data.size(); i++)
-                data[i] *= rhs.data[i];
+            parallelRange(0, true, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    data[i] *= rhs.data[i];
+            });
         } else
-            return Field<DTYPE,HCSTYPE>::operator *=(rhs);
+            return operator*= (static_cast<const Field<DTYPE, HCSTYPE>&>(rhs));
         return *this;
     }
 
+    Field<DTYPE, HCSTYPE>& operator*= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return *this *= FieldTerm<Field<DTYPE, HCSTYPE> >(rhs);
+    }
+
     Field<DTYPE, HCSTYPE>& operator*= (const DTYPE& rhs) {
-        for (size_t i = 0; i < data.size(); i++)
-            data[i] *= rhs;
+        parallelRange(0, true, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                data[i] *= rhs;
+        });
         return *this;
     }
 
 
     Field<DTYPE, HCSTYPE>& operator+= (const DenseField<DTYPE, HCSTYPE>& rhs) {
         if (sameStructure(rhs)) {
-            for (size_t i = 0; i < data.size(); i++)
-                data[i] += rhs.data[i];
+            parallelRange(0, true, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    data[i] += rhs.data[i];
+            });
         } else
-            return Field<DTYPE,HCSTYPE>::operator +=(rhs);
+            return operator+= (static_cast<const Field<DTYPE, HCSTYPE>&>(rhs));
         return *this;
     }
 
     Field<DTYPE, HCSTYPE>& operator+= (const Field<DTYPE, HCSTYPE>& rhs) {
-        return Field<DTYPE,HCSTYPE>::operator +=(rhs);
+        return *this += FieldTerm<Field<DTYPE, HCSTYPE> >(rhs);
     }
 
     Field<DTYPE, HCSTYPE>& operator+= (const DTYPE& rhs) {
-        for (size_t i = 0; i < data.size(); i++)
-            data[i] += rhs;
+        parallelRange(0, true, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                data[i] += rhs;
+        });
         return *this;
     }
 
     Field<DTYPE, HCSTYPE>& operator-= (const DenseField<DTYPE, HCSTYPE>& rhs) {
         if (sameStructure(rhs)) {
-            for (size_t i = 0; i < data.size(); i++)
-                data[i] -= rhs.data[i];
+            parallelRange(0, true, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    data[i] -= rhs.data[i];
+            });
         } else
-            return Field<DTYPE,HCSTYPE>::operator -=(rhs);
+            return operator-= (static_cast<const Field<DTYPE, HCSTYPE>&>(rhs));
         return *this;
     }
 
     Field<DTYPE, HCSTYPE>& operator-= (const Field<DTYPE, HCSTYPE>& rhs) {
-        return Field<DTYPE,HCSTYPE>::operator -=(rhs);
+        return *this -= FieldTerm<Field<DTYPE, HCSTYPE> >(rhs);
     }
 
     Field<DTYPE, HCSTYPE>& operator-= (const DTYPE& rhs) {
-        for (size_t i = 0; i < data.size(); i++)
-            data[i] -= rhs;
+        parallelRange(0, true, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                data[i] -= rhs;
+        });
         return *this;
     }
 
 
     Field<DTYPE, HCSTYPE>& operator/= (const DenseField<DTYPE, HCSTYPE>& rhs) {
         if (sameStructure(rhs)) {
-            for (size_t i = 0; i < data.size(); i++)
-                data[i] /= rhs.data[i];
+            parallelRange(0, true, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; i++)
+                    data[i] /= rhs.data[i];
+            });
         } else
-            return Field<DTYPE,HCSTYPE>::operator /=(rhs);
+            return operator/= (static_cast<const Field<DTYPE, HCSTYPE>&>(rhs));
         return *this;
     }
+    Field<DTYPE, HCSTYPE>& operator/= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return *this /= FieldTerm<Field<DTYPE, HCSTYPE> >(rhs);
+    }
+
     Field<DTYPE, HCSTYPE>& operator/= (const DTYPE& rhs) {
-        for (size_t i = 0; i < data.size(); i++)
-            data[i] /= rhs;
+        parallelRange(0, true, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                data[i] /= rhs;
+        });
         return *this;
     }
 
+    // convert() and merge() of Field with the callable inlined. With parallel the callable runs on SetThreads()
+    // threads at once if the sources allow concurrent reads, it must not touch shared state then.
+    template <typename DTYPE2, typename FN>
+    void convert(Field<DTYPE2, HCSTYPE> &source, FN convert_fn, bool parallel = false) {
+        forTop(parallel && source.concurrentReads(), [&](coord_t c, DTYPE& v) { v = convert_fn(c, source); });
+    }
 
-};
-
-// Other non-member arithmetic ops
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator* (const DenseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result *= rhs;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator* (const DenseField<DTYPE, HCSTYPE>& lhs, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result *= rhs;
-    return result;
-};
-
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator* (const DTYPE& val, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = rhs;
-    result *= val;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator* (const DenseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result *= val;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator/ (const DenseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result /= rhs;
-    return result;
-};
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator/ (const DTYPE& val, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = rhs;
-    for (auto e : result)
-        e.second = val / e.second;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator/ (const DenseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result /= val;
-    return result;
-}
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator+ (const DenseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result += rhs;
-    return result;
-};
+    template <typename DTYPE2, typename FN>
+    void merge(Field<DTYPE2, HCSTYPE> &source1, Field<DTYPE2, HCSTYPE> &source2, FN merge_fn, bool parallel = false) {
+        forTop(parallel && source1.concurrentReads() && source2.concurrentReads(), [&](coord_t c, DTYPE& v) {
+            v = merge_fn(c, source1.get(c), source2.get(c));
+        });
+    }
 
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator+ (const DenseField<DTYPE, HCSTYPE>& lhs, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result += rhs;
-    return result;
-};
 
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator+ (const DTYPE& val, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = rhs;
-    result += val;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator+ (const DenseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result += val;
-    return result;
-}
-
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator- (const DenseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result -= rhs;
-    return result;
 };
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator- (const DTYPE& val, const DenseField<DTYPE, HCSTYPE>& rhs) {
-    DenseField<DTYPE, HCSTYPE> result = -rhs;
-    result += val;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> DenseField<DTYPE, HCSTYPE> operator- (const DenseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    DenseField<DTYPE, HCSTYPE> result = lhs;
-    result -= val;
-    return result;
-}
 
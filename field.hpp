@@ -16,15 +16,61 @@
  * - A bracket operator for coordinates is implemented, with adjustable behavior for non-existing coords.
  * - The performance of exists() relies on STL's map::lower_bound O(log) complexity
  * - The center coordinate (0) always exists
- * - boundary conditions can be implemented as lambdas
+ * - Dirichlet, Neumann and reflecting boundary conditions built in, others can be implemented as lambdas
  *
  */
 
 using namespace std;
 using namespace hcs;
 
+// Everything that can be an operand of the lazy field arithmetic at the end of this file: fields and expressions
+struct FieldOperand {};
+struct FieldExprNode : FieldOperand {};
+
+// Consecutive coords of one level stored as one array, see levels() of DenseField and SparseField
+template <typename DTYPE>
+struct FieldSpan {
+    level_t level;
+    coord_t start, end;     // first and last coord
+    DTYPE* values;
+    const char* top;        // one flag per value, or NULL if all_top tells for all of them
+    bool all_top;
+
+    size_t size() const { return end - start + 1; }
+    coord_t coord(size_t i) const { return start + i; }
+    DTYPE& operator[](size_t i) const { return values[i]; }
+    bool isTop(size_t i) const { return top != NULL ? top[i] : all_top; }
+};
+
+// The mirror image of a value at a boundary normal to dimension dim, see Field::BC_REFLECT. Scalars are
+// unchanged, Tensor1 negates its normal component (tensor.hpp).
+template <typename T>
+inline T reflect(const T& value, uint8_t dim) {
+    return value;
+}
+
+// Reads a field with the lookups of FTYPE. These may share a cache with all other readers of the field, so
+// accessors of one field only work from several threads at once if concurrent(), see SparseField::Accessor.
+template <typename FTYPE>
+class FieldAccessor {
+public:
+    typedef typename FTYPE::value_t value_t;
+
+    FieldAccessor(FTYPE& field) : field(&field) {}
+
+    bool exists(coord_t coord) { return field->exists(coord); }
+    bool isTop(coord_t coord) { return field->isTop(coord); }
+    value_t& getDirect(coord_t coord) { return field->getDirect(coord); }
+    value_t get(coord_t coord, bool use_non_top = true) { return field->get(coord, use_non_top); }
+    value_t* contiguousAt(coord_t coord, coord_t& run_end) { return field->contiguousAt(coord, run_end); }
+    bool concurrent() { return field->concurrentReads(); }
+
+private:
+    FTYPE* field;
+};
+
 template <typename DTYPE, typename HCSTYPE>
-class Field {
+class Field : public FieldOperand {
 
 public:
 
@@ -33,6 +79,8 @@ public:
             bf = nullptr;
         for (bool &bf_prop : boundary_propagate)
             bf_prop = true;
+        boundary_kind.fill(BC_DIRICHLET);
+        boundary_value.fill(DTYPE(0));
     }
 
     Field() : Field(HCSTYPE()) {}
@@ -54,6 +102,35 @@ public:
     array<function<DTYPE(Field<DTYPE, HCSTYPE> *self, coord_t origin)>, 64> boundary; // max 32 dimensions
     array<bool, 64> boundary_propagate;												  // if this field is copied, is the boundary function copied too?
 
+    // Built-in boundary conditions per direction (0 = X+, 1 = X-, 2 = Y+ ...), evaluated inline by get().
+    // A function in boundary[] takes priority, the set..() methods below remove it.
+    //   BC_DIRICHLET: boundary_value of the direction, 0 by default
+    //   BC_NEUMANN: the value of the interior coord that hit the boundary, derivative == 0
+    //   BC_REFLECT: BC_NEUMANN with the component normal to the boundary negated, see reflect()
+    enum BoundaryKind { BC_DIRICHLET, BC_NEUMANN, BC_REFLECT };
+    array<BoundaryKind, 64> boundary_kind;
+    array<DTYPE, 64> boundary_value;
+
+    // direction -1 sets all directions
+    void setDirichlet(const DTYPE& value, int direction = -1) {
+        setBoundary(BC_DIRICHLET, direction, value);
+    }
+
+    // One value per direction
+    template <size_t N>
+    void setDirichlet(const array<DTYPE, N>& values) {
+        for (size_t i = 0; i < N; i++)
+            setBoundary(BC_DIRICHLET, i, values[i]);
+    }
+
+    void setNeumann(int direction = -1) {
+        setBoundary(BC_NEUMANN, direction, DTYPE(0));
+    }
+
+    void setReflect(int direction = -1) {
+        setBoundary(BC_REFLECT, direction, DTYPE(0));
+    }
+
     // If a value is accessed via [], and if that value does not exist:
     //   BR_THROW: throws range_error, slow if it happens often.
     //   BR_REFINE: brings requested coord into existence via refineToCoord(), might be very slow
@@ -68,8 +145,10 @@ public:
     DTYPE		intermediate;
 
     //  The type to store a list of coords and their coefficients.
-    //  It is a map instead of a vector because of unique coord elimination.
-    typedef map<coord_t, data_t> coeff_map_t;
+    //  Sorted with unique coord elimination like a map, but without allocations for usual stencils.
+    typedef CoeffSet<4 * HCSTYPE::parts> coeff_map_t;
+
+    typedef DTYPE value_t;
 
 
 public:
@@ -141,25 +220,36 @@ public:
     virtual DTYPE get(coord_t coord, bool use_non_top = true) = 0;
 
     void get(coord_t coord, DTYPE& result, bool use_non_top = true) {
+        getT(this, coord, result, use_non_top);
+    }
+
+    // Interpolation core of get(). SELF is the class to ask for exists(), isTop() and getDirect(): Field itself
+    // dispatches virtually, DenseField and SparseField pass themselves and get these lookups inlined.
+    template <typename SELF>
+    void getT(SELF* self, coord_t coord, DTYPE& result, bool use_non_top) {
         if (hcs.IsBoundary(coord)) {
             uint8_t boundary_index = hcs.GetBoundaryDirection(coord);
             if (boundary[boundary_index] != nullptr)
                 result = boundary[boundary_index](this, coord);
+            else if (boundary_kind[boundary_index] == BC_DIRICHLET)
+                result = boundary_value[boundary_index];
             else {
-                result = 0;
+                DTYPE inner = 0;
+                getT(self, hcs.removeBoundary(coord), inner, use_non_top);
+                result = boundary_kind[boundary_index] == BC_REFLECT ? reflect(inner, boundary_index / 2) : inner;
             }
             return;
         }
-        if (exists(coord)) {
-            if (use_non_top || isTop(coord)) {
-                result += getDirect(coord);
+        if (self->exists(coord)) {
+            if (use_non_top || self->isTop(coord)) {
+                result += self->getDirect(coord);
                 return;
             } else {
                 for (uint16_t direction = 0; direction < hcs.parts; direction++) {
                     //coeff_up_count++;
                     DTYPE partial = 0;
                     //getCoeffs(hcs.IncreaseLevel(coord, direction), partial, use_non_top, recursion + 1);
-                    get(hcs.IncreaseLevel(coord, direction), partial, use_non_top);
+                    getT(self, hcs.IncreaseLevel(coord, direction), partial, use_non_top);
                     partial /= (data_t)hcs.parts;
                     result += partial;
                 }
@@ -169,19 +259,139 @@ public:
         	for (auto coeff : coeffs) {
         		coord_t current = coeff.first;
         		data_t weight = coeff.second;
-                bool current_exists = exists(current);
-                if (!current_exists || (current_exists && !isTop(current) && !use_non_top)) {
+                bool current_exists = self->exists(current);
+                if (!current_exists || (current_exists && !self->isTop(current) && !use_non_top)) {
                     // we either have a non-existent coord or an existing non-top coord that we shall not use.
                     DTYPE partial = 0;
-                    get(current, partial, use_non_top);
+                    getT(self, current, partial, use_non_top);
                     result += partial * weight;
                 } else { // current_exists = true in this branch, so _current is valid.
-                    result += getDirect(current) * weight;
+                    result += self->getDirect(current) * weight;
                 }
         	}
         }
     }
 
+    // get() for n coords at once, results[i] equals get(coords[i]) bit for bit. The coords are read in bucket order
+    // (RadixSort), so consecutive lookups mostly hit the same bucket, duplicates are read once, and interpolated
+    // values of missing coords are memoized: sibling coords interpolate from the same parents.
+    void getMany(const coord_t* coords, size_t n, DTYPE* results, bool use_non_top = true) {
+        getManyT(this, coords, n, results, use_non_top);
+    }
+
+    // Core of getMany(), SELF as for getT()
+    template <typename SELF>
+    void getManyT(SELF* self, const coord_t* coords, size_t n, DTYPE* results, bool use_non_top) {
+        if (n == 0)
+            return;
+        vector<coord_t> sorted(coords, coords + n);
+        vector<size_t> order(n);
+        iota(order.begin(), order.end(), 0);
+        RadixSort(&sorted[0], &order[0], n);
+        InterpolationMemo memo(n);
+        DTYPE value = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (i == 0 || sorted[i] != sorted[i - 1])
+                value = getMemoT(self, sorted[i], use_non_top, memo);
+            results[order[i]] = value;
+        }
+    }
+
+private:
+    // Interpolated values of missing coords for getMany(), direct-mapped: a collision replaces the older value.
+    // Boundary coords are never stored, so their marker bit flags empty slots. At least 2n slots for n coords,
+    // 16 to 4096, so small calls (dot() with a few missing coords) do not set up the full table.
+    struct InterpolationMemo {
+        int bits;
+        vector<coord_t> keys;
+        vector<DTYPE> values;
+
+        InterpolationMemo(size_t n) : bits(4) {
+            while (bits < 12 && ((size_t)1 << bits) < 2 * n)
+                bits++;
+            keys.assign((size_t)1 << bits, (coord_t)1 << (HCS_COORD_BITS - 1));
+            values.resize((size_t)1 << bits);
+        }
+
+        size_t slot(coord_t coord) {
+            return size_t((uint64_t(coord) * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+        }
+    };
+
+    // getT() with the missing coords of the interpolation, the requested one included, read from and added to memo
+    template <typename SELF>
+    DTYPE getMemoT(SELF* self, coord_t coord, bool use_non_top, InterpolationMemo& memo) {
+        DTYPE result = 0;
+        if (hcs.IsBoundary(coord) || self->exists(coord)) {
+            getT(self, coord, result, use_non_top);
+            return result;
+        }
+        size_t slot = memo.slot(coord);
+        if (memo.keys[slot] == coord)
+            return memo.values[slot];
+        auto coeffs = hcs.getCoeffs(coord);
+        for (auto coeff : coeffs) {
+            coord_t current = coeff.first;
+            data_t weight = coeff.second;
+            bool current_exists = self->exists(current);
+            if (!current_exists || (!self->isTop(current) && !use_non_top))
+                result += getMemoT(self, current, use_non_top, memo) * weight;
+            else
+                result += self->getDirect(current) * weight;
+        }
+        memo.keys[slot] = coord;
+        memo.values[slot] = result;
+        return result;
+    }
+
+public:
+
+    // Can get(), exists() and contiguousAt() be called from several threads at once?
+    // Field-wide operations only read operands in parallel if they can, see parallel.hpp.
+    virtual bool concurrentReads() {
+        return false;
+    }
+
+    // Read-only access for one thread, one per thread: Accessor a(field); a.get(coord);
+    typedef FieldAccessor<Field> Accessor;
+
+    // Pointer to the value of coord if it is stored, otherwise NULL. Narrows run_end to the last coord of the run
+    // that starts at coord and is either stored consecutively or missing entirely.
+    // Lets field expressions walk operands of another structure run by run instead of coord by coord.
+    virtual DTYPE* contiguousAt(coord_t coord, coord_t& run_end) {
+        return NULL;
+    }
+
+    // Applies op(dst[i], value of expr at start + i) for the run start..end of a field, see FieldTerm.
+    // The run is split where the storage of an operand changes, pieces where all operands are stored are plain
+    // array loops, only the others read missing coords with get().
+    template <typename E, typename OP>
+    static void evaluateRun(E& expr, coord_t start, coord_t end, DTYPE* dst, OP op) {
+        for (coord_t first = start; first <= end; ) {
+            coord_t last = end;
+            bool bound = expr.bind(first, last);
+            DTYPE* d = dst + (first - start);
+            size_t n = last - first + 1;
+            if (bound) {
+                for (size_t i = 0; i < n; i++)
+                    op(d[i], expr[i]);
+            } else {
+                for (size_t i = 0; i < n; i++)
+                    op(d[i], expr.at(first + i, i));
+            }
+            first = last + 1;
+        }
+    }
+
+    // The field of type F an expression takes its structure from
+    template <typename F, typename E>
+    static const F& structureOf(const E& expr) {
+        const F* result = expr.template structure<F>();
+        if (result == NULL)
+            throw invalid_argument("Field expression has no operand of the field type to take the structure from");
+        return *result;
+    }
+
     // Do coordinates exist in a higher level?
     virtual bool isTop(coord_t coord) = 0;	// Average all non-top coords from top-level
 
@@ -189,6 +399,16 @@ public:
     // If there would be a reverse iterator, a generic algorithm would be possible here...
     virtual void propagate() = 0;
 
+    // Incremental propagate(): after changing a few values of a propagated field, mark each changed coord with
+    // markDirty() and propagateDirty() re-averages only their ancestor chains. The result is the same as that
+    // of propagate(), which also clears all marks. Copies, constructed or assigned, take the marks of their source.
+    virtual void markDirty(coord_t coord) = 0;
+    virtual void propagateDirty() = 0;
+
+    // The stored values of the levels lo .. hi (-1: highest) as spans of consecutive coords, in ascending coord
+    // order or descending. Values can be read and written through the spans until the structure changes.
+    virtual vector<FieldSpan<DTYPE> > levels(int lo = 0, int hi = -1, bool descending = false) = 0;
+
     // Return interpolation coeffs and their associated >existing< coords.
     // The first value of the pair is the coefficient, always >0 and <=1.
     // If the coord exists the returning vector will be of size 1 and first=1., second=coord.
@@ -196,6 +416,12 @@ public:
     // to set non-top values to their averaged versions from top-level values.
     // never use recursion parameter, its purely internal to protect the stack.
     void getCoeffs(const coord_t coord, coeff_map_t &coeffs, bool use_non_top = true, int recursion = 0) {
+        getCoeffsT(this, coord, coeffs, use_non_top, recursion);
+    }
+
+    // Core of getCoeffs(), SELF as for getT()
+    template <typename SELF>
+    void getCoeffsT(SELF* self, const coord_t coord, coeff_map_t &coeffs, bool use_non_top, int recursion) {
         if (hcs.IsBoundary(coord)) {
             coeffs[coord] = 1.;
             return;
@@ -204,14 +430,14 @@ public:
             cout << "RECURSION LIMIT REACHED (" << hcs.max_level << ") coord: " << hcs.toString(coord) << endl;
             exit(1);
         }
-        if (exists(coord)) {
-            if (isTop(coord) || use_non_top) {
+        if (self->exists(coord)) {
+            if (self->isTop(coord) || use_non_top) {
                 coeffs[coord] = 1.;
                 return;
             } else {
                 for (uint16_t direction = 0; direction < hcs.parts; direction++) {
                     coeff_map_t partial;
-                    getCoeffs(hcs.IncreaseLevel(coord, direction), partial, use_non_top, recursion + 1);
+                    getCoeffsT(self, hcs.IncreaseLevel(coord, direction), partial, use_non_top, recursion + 1);
                     for (auto &coeff : partial)
                         coeff.second /= hcs.parts;
                     coeffs.insert(partial.begin(), partial.end());
@@ -225,11 +451,11 @@ public:
                 data_t &weight = sub_coeff.second;
                 if (weight == 0)
                     continue;
-                bool current_exists = exists(current);
-                if (!current_exists || (current_exists && !isTop(current) && !use_non_top)) {
+                bool current_exists = self->exists(current);
+                if (!current_exists || (current_exists && !self->isTop(current) && !use_non_top)) {
                     // we either have a non-existent coord or an existing non-top coord that we shall not use.
                     coeff_map_t partial;
-                    getCoeffs(current, partial, use_non_top, recursion + 1);
+                    getCoeffsT(self, current, partial, use_non_top, recursion + 1);
                     for (auto &coeff : partial)
                         coeffs[coeff.first] += coeff.second * weight;
                 } else { // current_exists = true in this branch, so _current is valid.
@@ -348,77 +574,200 @@ public:
     // Empties all data
     virtual void clear() = 0;
 
+protected:
+    // Takes the boundary conditions of f where boundary_propagate allows it, the others become Dirichlet 0
+    void copyBoundary(const Field& f) {
+        boundary_propagate = f.boundary_propagate;
+        for (int i = 0; i < 64; i++) {
+            boundary[i] = boundary_propagate[i] ? f.boundary[i] : nullptr;
+            boundary_kind[i] = boundary_propagate[i] ? f.boundary_kind[i] : BC_DIRICHLET;
+            boundary_value[i] = boundary_propagate[i] ? f.boundary_value[i] : DTYPE(0);
+        }
+    }
+
+private:
+    void setBoundary(BoundaryKind kind, int direction, const DTYPE& value) {
+        for (int i = 0; i < 2 * hcs.GetDimensions(); i++)
+            if (direction < 0 || direction == i) {
+                boundary[i] = nullptr;
+                boundary_kind[i] = kind;
+                boundary_value[i] = value;
+            }
+    }
+
 
 };
 
-// Other non-member arithmetic ops
-// serve as template for overriding, result and LHS must be of inherited class, RHS can stay generic field as its iterator / copy constructpr is not needed
-/*
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator* (const Field<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result *= rhs;
-	return result;
+// Lazy arithmetic on fields.
+// a + b, 2. * a, -(a - b) / c, ... only build small expression objects holding pointers to the fields. Assigning
+// an expression to a DenseField or SparseField (=, +=, -=, *=, /= or construction) evaluates it in a single pass
+// over the structure of the target, run by run (a level of a DenseField, a bucket of a SparseField).
+// Operands are walked along with the target (contiguousAt()): where they store the coords too they are read as
+// plain arrays, only coords they lack are read with get() and interpolate, like the old "a * b keeps the
+// structure of a". A constructed field takes the structure of
+// the first operand of its own type. With SetThreads() the runs are evaluated in parallel if all operands allow
+// concurrent reads through their Accessor.
+
+template <typename FTYPE>
+class FieldTerm : public FieldExprNode {
+public:
+    typedef typename FTYPE::value_t value_t;
+
+    FieldTerm(const FTYPE& f) : field(const_cast<FTYPE*>(&f)), reader(*field), values(NULL) {}
+
+    bool bind(coord_t start, coord_t& end) {
+        values = reader.contiguousAt(start, end);
+        return values != NULL;
+    }
+    value_t operator[](size_t i) const { return values[i]; }
+    value_t at(coord_t coord, size_t i) const { return values ? values[i] : reader.get(coord); }
+    bool concurrent() const { return reader.concurrent(); }
+
+    template <typename F>
+    const F* structure() const { return dynamic_cast<const F*>(field); }
+
+private:
+    FTYPE* field;
+    mutable typename FTYPE::Accessor reader;    // each thread evaluates its own copy of the expression
+    value_t* values;
+};
+
+template <typename DTYPE>
+class FieldScalar : public FieldExprNode {
+public:
+    typedef DTYPE value_t;
+
+    FieldScalar(const DTYPE& value) : value(value) {}
+
+    bool bind(coord_t start, coord_t& end) { return true; }
+    value_t operator[](size_t i) const { return value; }
+    value_t at(coord_t coord, size_t i) const { return value; }
+    bool concurrent() const { return true; }
+
+    template <typename F>
+    const F* structure() const { return NULL; }
+
+private:
+    DTYPE value;
+};
+
+template <typename OP, typename L, typename R>
+class FieldBinary : public FieldExprNode {
+public:
+    typedef typename L::value_t value_t;
+
+    FieldBinary(const L& l, const R& r) : l(l), r(r) {}
+
+    bool bind(coord_t start, coord_t& end) {
+        bool bound_l = l.bind(start, end);
+        bool bound_r = r.bind(start, end);
+        return bound_l && bound_r;
+    }
+    value_t operator[](size_t i) const { return OP::apply(l[i], r[i]); }
+    value_t at(coord_t coord, size_t i) const { return OP::apply(l.at(coord, i), r.at(coord, i)); }
+    bool concurrent() const { return l.concurrent() && r.concurrent(); }
+
+    template <typename F>
+    const F* structure() const {
+        const F* result = l.template structure<F>();
+        return result ? result : r.template structure<F>();
+    }
+
+private:
+    L l;
+    R r;
 };
 
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator* (const DTYPE& val, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = rhs;
-	result *= val;
-	return result;
+template <typename E>
+class FieldNegate : public FieldExprNode {
+public:
+    typedef typename E::value_t value_t;
+
+    FieldNegate(const E& e) : e(e) {}
+
+    bool bind(coord_t start, coord_t& end) { return e.bind(start, end); }
+    value_t operator[](size_t i) const { return -e[i]; }
+    value_t at(coord_t coord, size_t i) const { return -e.at(coord, i); }
+    bool concurrent() const { return e.concurrent(); }
+
+    template <typename F>
+    const F* structure() const { return e.template structure<F>(); }
+
+private:
+    E e;
 };
 
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator* (const Field<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result *= val;
-	return result;
+// Can expression E have an operand of type F to take the structure from? A term of a base class of F may be one
+// at runtime, structure() tells.
+template <typename F, typename E>
+struct FieldExprHasStructure : integral_constant<bool, false> {};
+
+template <typename F, typename FTYPE>
+struct FieldExprHasStructure<F, FieldTerm<FTYPE> > : integral_constant<bool, is_base_of<FTYPE, F>::value> {};
+
+template <typename F, typename OP, typename L, typename R>
+struct FieldExprHasStructure<F, FieldBinary<OP, L, R> >
+    : integral_constant<bool, FieldExprHasStructure<F, L>::value || FieldExprHasStructure<F, R>::value> {};
+
+template <typename F, typename E>
+struct FieldExprHasStructure<F, FieldNegate<E> > : FieldExprHasStructure<F, E> {};
+
+struct FieldAdd { template <typename T> static T apply(const T& a, const T& b) { return a + b; } };
+struct FieldSub { template <typename T> static T apply(const T& a, const T& b) { return a - b; } };
+struct FieldMul { template <typename T> static T apply(const T& a, const T& b) { return a * b; } };
+struct FieldDiv { template <typename T> static T apply(const T& a, const T& b) { return a / b; } };
+
+// Fields become FieldTerms, expressions stay as they are
+template <typename T, bool is_expr = is_base_of<FieldExprNode, T>::value>
+struct FieldExprOf {
+    typedef T type;
+    static const T& make(const T& t) { return t; }
 };
 
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator/ (const Field<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result /= rhs;
-	return result;
+template <typename T>
+struct FieldExprOf<T, false> {
+    typedef FieldTerm<T> type;
+    static type make(const T& t) { return type(t); }
 };
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator/ (const DTYPE& val, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = rhs;
-	for (auto e : result)
-		e.second = val / e.second;
-	return result;
-}
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator/ (const Field<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result /= val;
-	return result;
-}
 
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator+ (const Field<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result += rhs;
-	return result;
+// Result type of a binary op of two operands, or of an operand and a scalar.
+// Empty for non-operands, so the operators below drop out of overload resolution for other types.
+template <typename OP, typename L, typename R, bool = is_base_of<FieldOperand, L>::value && is_base_of<FieldOperand, R>::value>
+struct FieldBinaryOf {};
+
+template <typename OP, typename L, typename R>
+struct FieldBinaryOf<OP, L, R, true> {
+    typedef FieldBinary<OP, typename FieldExprOf<L>::type, typename FieldExprOf<R>::type> type;
+    static type make(const L& l, const R& r) { return type(FieldExprOf<L>::make(l), FieldExprOf<R>::make(r)); }
 };
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator+ (const DTYPE& val, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = rhs;
-	result += val;
-	return result;
-}
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator+ (const Field<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result += val;
-	return result;
-}
 
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator- (const Field<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result -= rhs;
-	return result;
+template <typename OP, typename T, bool = is_base_of<FieldOperand, T>::value>
+struct FieldScalarOf {};
+
+template <typename OP, typename T>
+struct FieldScalarOf<OP, T, true> {
+    typedef FieldScalar<typename T::value_t> scalar;
+    typedef FieldBinary<OP, typename FieldExprOf<T>::type, scalar> right;
+    typedef FieldBinary<OP, scalar, typename FieldExprOf<T>::type> left;
 };
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator- (const DTYPE& val, const Field<DTYPE, HCSTYPE>& rhs) {
-	Field<DTYPE, HCSTYPE> result = -rhs;
-	result += val;
-	return result;
-}
-template <typename DTYPE, typename HCSTYPE> Field<DTYPE, HCSTYPE> operator- (const Field<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-	Field<DTYPE, HCSTYPE> result = lhs;
-	result -= val;
-	return result;
+
+template <typename L, typename R> typename FieldBinaryOf<FieldAdd, L, R>::type operator+ (const L& l, const R& r) { return FieldBinaryOf<FieldAdd, L, R>::make(l, r); }
+template <typename L, typename R> typename FieldBinaryOf<FieldSub, L, R>::type operator- (const L& l, const R& r) { return FieldBinaryOf<FieldSub, L, R>::make(l, r); }
+template <typename L, typename R> typename FieldBinaryOf<FieldMul, L, R>::type operator* (const L& l, const R& r) { return FieldBinaryOf<FieldMul, L, R>::make(l, r); }
+template <typename L, typename R> typename FieldBinaryOf<FieldDiv, L, R>::type operator/ (const L& l, const R& r) { return FieldBinaryOf<FieldDiv, L, R>::make(l, r); }
+
+template <typename T> typename FieldScalarOf<FieldAdd, T>::right operator+ (const T& t, const typename T::value_t& val) { return typename FieldScalarOf<FieldAdd, T>::right(FieldExprOf<T>::make(t), val); }
+template <typename T> typename FieldScalarOf<FieldSub, T>::right operator- (const T& t, const typename T::value_t& val) { return typename FieldScalarOf<FieldSub, T>::right(FieldExprOf<T>::make(t), val); }
+template <typename T> typename FieldScalarOf<FieldMul, T>::right operator* (const T& t, const typename T::value_t& val) { return typename FieldScalarOf<FieldMul, T>::right(FieldExprOf<T>::make(t), val); }
+template <typename T> typename FieldScalarOf<FieldDiv, T>::right operator/ (const T& t, const typename T::value_t& val) { return typename FieldScalarOf<FieldDiv, T>::right(FieldExprOf<T>::make(t), val); }
+
+template <typename T> typename FieldScalarOf<FieldAdd, T>::left operator+ (const typename T::value_t& val, const T& t) { return typename FieldScalarOf<FieldAdd, T>::left(val, FieldExprOf<T>::make(t)); }
+template <typename T> typename FieldScalarOf<FieldSub, T>::left operator- (const typename T::value_t& val, const T& t) { return typename FieldScalarOf<FieldSub, T>::left(val, FieldExprOf<T>::make(t)); }
+template <typename T> typename FieldScalarOf<FieldMul, T>::left operator* (const typename T::value_t& val, const T& t) { return typename FieldScalarOf<FieldMul, T>::left(val, FieldExprOf<T>::make(t)); }
+template <typename T> typename FieldScalarOf<FieldDiv, T>::left operator/ (const typename T::value_t& val, const T& t) { return typename FieldScalarOf<FieldDiv, T>::left(val, FieldExprOf<T>::make(t)); }
+
+template <typename T>
+typename enable_if<is_base_of<FieldOperand, T>::value, FieldNegate<typename FieldExprOf<T>::type> >::type operator- (const T& t) {
+    return FieldNegate<typename FieldExprOf<T>::type>(FieldExprOf<T>::make(t));
 }
- */
 
@@ -60,7 +60,7 @@
  *	 has a completely different "true" location than the same coordinate at a different level!
  *
  *	 The HCS template library is independent of most other libs, exception is the toString() method.
- *	 Intel/AMD CPUs greatly profit from BMI2 instruction set.
+ *	 Intel/AMD CPUs greatly profit from BMI2 instruction set, which is detected at runtime (see Morton below).
  *
  * 	 Boundary coordinates
  * 	 ====================
@@ -74,9 +74,10 @@
 
 #pragma once
 
-#ifdef __BMI2__
+#if defined(__x86_64__) || defined(__i386__)
 #include <immintrin.h>
-
+#include <cpuid.h>
+#define HCS_X86
 #endif
 
 namespace hcs {
@@ -85,84 +86,624 @@ namespace hcs {
 
 using namespace std;
 
+// The x86 SIMD kernels (batched neighbors and positions) work on 64 bit lanes
+#if defined(HCS_X86) && HCS_COORD_WIDTH == 64
+#define HCS_SIMD
+#endif
+
+// Keeps the n lowest bits of coord, n must be below HCS_COORD_BITS
+inline __attribute__((always_inline)) coord_t LowBits(coord_t coord, unsigned n) {
+#if defined(__BMI2__) && HCS_COORD_WIDTH == 64
+	return _bzhi_u64(coord, n);
+#elif defined(__BMI2__) && HCS_COORD_WIDTH == 32
+	return _bzhi_u32(coord, n);
+#else
+	return coord & (((coord_t)1 << n) - 1);
+#endif
+}
+
+// 3^n, for the size of Moore neighborhoods
+constexpr size_t Pow3(size_t n) {
+	return n == 0 ? 1 : 3 * Pow3(n - 1);
+}
+
+// Morton (de-)interleaving is the core of every conversion between coords and unscaled positions.
+// There are several ways to do it and the fastest one depends on the CPU, not on the compiler flags:
+//   MORTON_PDEP:   BMI2 pdep / pext, one instruction. Microcoded and very slow on AMD before Zen3 though.
+//   MORTON_AVX512: AVX-512 VBMI byte permute (deposit) and BITALG bit shuffle (extract).
+//   MORTON_MAGIC:  shift-and-mask dilation with magic numbers, log2(bits) steps of plain integer ops.
+//   MORTON_LUT:    byte-wise lookup tables.
+// The method is picked once per process with cpuid, so a single binary runs well on all machines.
+// It can be forced with the environment variable HCS_MORTON=pdep|avx512|magic|lut or SetMortonMethod().
+enum morton_method_t { MORTON_PDEP, MORTON_AVX512, MORTON_MAGIC, MORTON_LUT };
+
+inline bool MortonMethodSupported(morton_method_t method) {
+#ifdef HCS_X86
+	__builtin_cpu_init();
+	if (method == MORTON_PDEP)	// there is no 128 bit pdep
+		return HCS_COORD_WIDTH <= 64 && __builtin_cpu_supports("bmi2");
+	if (method == MORTON_AVX512)	// the permutes work on a 64 bit coord
+		return HCS_COORD_WIDTH == 64 && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi") && __builtin_cpu_supports("avx512bitalg");
+#else
+	if (method == MORTON_PDEP || method == MORTON_AVX512)
+		return false;
+#endif
+	return true;
+}
+
+inline morton_method_t DetectMortonMethod() {
+	const char* names[] = { "pdep", "avx512", "magic", "lut" };
+	const char* env = getenv("HCS_MORTON");
+	for (int m = 0; env != NULL && m < 4; m++)
+		if (strcmp(env, names[m]) == 0 && MortonMethodSupported(morton_method_t(m)))
+			return morton_method_t(m);
+#ifdef HCS_X86
+	bool slow_pdep = false;
+	unsigned eax, ebx, ecx, edx;
+	if (__builtin_cpu_is("amd") && __get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		unsigned family = (eax >> 8) & 0xf;
+		if (family == 0xf)
+			family += (eax >> 20) & 0xff;
+		slow_pdep = family < 0x19; // Zen3 is family 19h, everything before microcodes pdep / pext
+	}
+	if (MortonMethodSupported(MORTON_PDEP) && !slow_pdep)
+		return MORTON_PDEP;
+	if (MortonMethodSupported(MORTON_AVX512))
+		return MORTON_AVX512;
+#endif
+	return MORTON_MAGIC;
+}
+
+inline morton_method_t& MortonMethod() {
+	static morton_method_t method = DetectMortonMethod();
+	return method;
+}
+
+// Every Morton<dimensions> in use registers here how to resolve its function pointers from MortonMethod()
+inline vector<void (*)()>& MortonResolvers() {
+	static vector<void (*)()> resolvers;
+	return resolvers;
+}
+
+// Returns false (and changes nothing) if the CPU does not support the method.
+// Not thread safe: the conversions read the resolved function pointers unsynchronized, so call it before any
+// threads are started (SetThreads(), the thread pool) or converting coords.
+inline bool SetMortonMethod(morton_method_t method) {
+	if (!MortonMethodSupported(method))
+		return false;
+	MortonMethod() = method;
+	for (auto resolve : MortonResolvers())
+		resolve();
+	return true;
+}
+
+// Bit masks for the magic-number dilation: blocks of size bits, repeating every size * dimensions bits.
+// Blocks of size 1 are every dimensions-th bit.
+constexpr coord_t MortonMask(size_t dimensions, size_t size, size_t bit = 0) {
+	return bit >= HCS_COORD_BITS ? 0 : ((bit % (size * dimensions)) < size ? (coord_t)1 << bit : 0) | MortonMask(dimensions, size, bit + 1);
+}
+
+// Bits per dimension in a coord next to the level-marker and boundary bits. This is also the highest level,
+// capped so that 2^level still fits into an unscaled_coord_t.
+constexpr level_t MaxBits(size_t dimensions) {
+	return (HCS_COORD_BITS - 2 - dimensions) / dimensions < sizeof(unscaled_coord_t) * 8 - 1 ?
+			(HCS_COORD_BITS - 2 - dimensions) / dimensions : sizeof(unscaled_coord_t) * 8 - 1;
+}
+
+// Number of dilation steps (log2 of the largest block size) to cover bits
+constexpr level_t MortonSteps(size_t bits, level_t steps = 0) {
+	return ((size_t)2 << steps) >= bits ? steps : MortonSteps(bits, steps + 1);
+}
+
+// Dilate() spreads the bits of an unscaled value to every dimensions-th bit (the X positions of a coord),
+// Compact() collects every dimensions-th bit of a coord back into an unscaled value. Shift by the dimension
+// for Y, Z,... The level-marker bit must be removed before Compact(), otherwise it counts as X bit.
+template<size_t dimensions>
+class Morton {
+public:
+	static const level_t max_bits = MaxBits(dimensions);	// bits per dimension in a coord
+
+	// Through the function pointers of MortonMethod(), resolved once when the program starts and again by
+	// SetMortonMethod(). Magic before that, during static initialization.
+	static coord_t Dilate(unscaled_coord_t value) {
+		(void)registered;
+		return dilate(value);
+	}
+
+	static unscaled_coord_t Compact(coord_t coord) {
+		(void)registered;
+		return compact(coord);
+	}
+
+	// Every dimensions-th bit, starting with the LSB
+	static constexpr coord_t dimension_mask = MortonMask(dimensions, 1);
+
+	// Steps and masks of the magic-number dilation, magic_masks[step] has blocks of 2^step bits.
+	static constexpr level_t magic_steps = MortonSteps(max_bits);
+	static constexpr coord_t magic_masks[8] = { MortonMask(dimensions, 1), MortonMask(dimensions, 2), MortonMask(dimensions, 4),
+			MortonMask(dimensions, 8), MortonMask(dimensions, 16), MortonMask(dimensions, 32), MortonMask(dimensions, 64), MortonMask(dimensions, 128) };
+
+	// Magic-number dilation of 64 bit lanes, for the batched conversions in HCS
+#if defined(HCS_SIMD) && defined(__AVX512F__)
+	static __m512i Dilate(__m512i x) {
+		for (int step = dimensions == 1 ? -1 : magic_steps; step >= 0; step--)
+			x = _mm512_and_si512(_mm512_or_si512(x, _mm512_sll_epi64(x, _mm_cvtsi32_si128((1U << step) * (dimensions - 1)))), _mm512_set1_epi64(magic_masks[step]));
+		return x;
+	}
+
+	static __m512i Compact(__m512i x) {
+		if (dimensions == 1)
+			return x;
+		x = _mm512_and_si512(x, _mm512_set1_epi64(magic_masks[0]));
+		for (int step = 0; step <= magic_steps; step++)
+			x = _mm512_and_si512(_mm512_or_si512(x, _mm512_srl_epi64(x, _mm_cvtsi32_si128((1U << step) * (dimensions - 1)))), _mm512_set1_epi64(magic_masks[step + 1]));
+		return x;
+	}
+#endif
+#if defined(HCS_SIMD) && defined(__AVX2__)
+	static __m256i Dilate(__m256i x) {
+		for (int step = dimensions == 1 ? -1 : magic_steps; step >= 0; step--)
+			x = _mm256_and_si256(_mm256_or_si256(x, _mm256_sll_epi64(x, _mm_cvtsi32_si128((1U << step) * (dimensions - 1)))), _mm256_set1_epi64x(magic_masks[step]));
+		return x;
+	}
+
+	static __m256i Compact(__m256i x) {
+		if (dimensions == 1)
+			return x;
+		x = _mm256_and_si256(x, _mm256_set1_epi64x(magic_masks[0]));
+		for (int step = 0; step <= magic_steps; step++)
+			x = _mm256_and_si256(_mm256_or_si256(x, _mm256_srl_epi64(x, _mm_cvtsi32_si128((1U << step) * (dimensions - 1)))), _mm256_set1_epi64x(magic_masks[step + 1]));
+		return x;
+	}
+#endif
+
+private:
+	static coord_t (*dilate)(unscaled_coord_t);
+	static unscaled_coord_t (*compact)(coord_t);
+	static const bool registered;
+
+	static void Resolve() {
+		switch (MortonMethod()) {
+		case MORTON_PDEP: dilate = DilatePDEP; compact = CompactPDEP; break;
+		case MORTON_AVX512: dilate = DilateAVX512; compact = CompactAVX512; break;
+		case MORTON_LUT: dilate = DilateLUT; compact = CompactLUT; break;
+		default: dilate = DilateMagic; compact = CompactMagic; break;
+		}
+	}
+
+	static bool Register() {
+		MortonResolvers().push_back(Resolve);
+		Resolve();
+		return true;
+	}
+
+	static coord_t DilateMagic(unscaled_coord_t value) {
+		coord_t x = value;
+		if (dimensions == 1)
+			return x;
+		for (int step = magic_steps; step >= 0; step--)
+			x = (x | (x << ((1U << step) * (dimensions - 1)))) & magic_masks[step];
+		return x;
+	}
+
+	static unscaled_coord_t CompactMagic(coord_t x) {
+		if (dimensions == 1)
+			return x;
+		x &= magic_masks[0];
+		for (int step = 0; step <= magic_steps; step++)
+			x = (x | (x >> ((1U << step) * (dimensions - 1)))) & magic_masks[step + 1];
+		return x;
+	}
+
+	struct LookupTables {
+		coord_t dilate[256];					// a dilated byte
+		uint8_t compact[dimensions][256];		// the X bits of a byte, that has its first X bit at position [phase]
+
+		LookupTables() {
+			for (uint32_t b = 0; b < 256; b++) {
+				dilate[b] = 0;
+				for (uint32_t i = 0; i < 8; i++)
+					if (i * dimensions < HCS_COORD_BITS)
+						dilate[b] |= (coord_t)((b >> i) & 1) << (i * dimensions);
+				for (uint32_t phase = 0; phase < dimensions; phase++) {
+					compact[phase][b] = 0;
+					for (uint32_t i = (dimensions - phase) % dimensions, n = 0; i < 8; i += dimensions, n++)
+						compact[phase][b] |= ((b >> i) & 1) << n;
+				}
+			}
+		}
+	};
+
+	static const LookupTables& LUT() {
+		static LookupTables tables;
+		return tables;
+	}
+
+	static coord_t DilateLUT(unscaled_coord_t value) {
+		const LookupTables& lut = LUT();
+		coord_t x = 0;
+		for (uint32_t byte = 0; value != 0 && byte * 8 * dimensions < HCS_COORD_BITS; byte++, value >>= 8)
+			x |= lut.dilate[value & 0xff] << (byte * 8 * dimensions);
+		return x;
+	}
+
+	static unscaled_coord_t CompactLUT(coord_t x) {
+		const LookupTables& lut = LUT();
+		coord_t result = 0;
+		for (uint32_t bit = 0; x != 0; bit += 8, x >>= 8)
+			if (x & 0xff)	// the X bits below this byte are already collected, ceil(bit / dimensions)
+				result |= (coord_t)lut.compact[bit % dimensions][x & 0xff] << ((bit + dimensions - 1) / dimensions);
+		return result;
+	}
+
+#if defined(HCS_X86) && HCS_COORD_WIDTH == 32
+	__attribute__((target("bmi2")))
+	static coord_t DilatePDEP(unscaled_coord_t value) {
+		return _pdep_u32(value, dimension_mask);
+	}
+
+	__attribute__((target("bmi2")))
+	static unscaled_coord_t CompactPDEP(coord_t x) {
+		return _pext_u32(x, dimension_mask);
+	}
+
+	static coord_t DilateAVX512(unscaled_coord_t value) { return DilateMagic(value); }
+	static unscaled_coord_t CompactAVX512(coord_t x) { return CompactMagic(x); }
+#elif defined(HCS_X86) && HCS_COORD_WIDTH == 64
+	__attribute__((target("bmi2")))
+	static coord_t DilatePDEP(unscaled_coord_t value) {
+		return _pdep_u64(value, dimension_mask);
+	}
+
+	__attribute__((target("bmi2")))
+	static unscaled_coord_t CompactPDEP(coord_t x) {
+		return _pext_u64(x, dimension_mask);
+	}
+
+	// Byte indices for the AVX-512 permutes. Bit value 63 is always zero for 32 bit values.
+	struct AVX512Indices {
+		alignas(64) uint8_t dilate[64];	// byte (=bit) p of the result comes from byte p / dimensions of the value
+		alignas(64) uint8_t compact[64];	// bit k of the result is bit k * dimensions of the coord
+
+		AVX512Indices() {
+			for (uint32_t p = 0; p < 64; p++) {
+				dilate[p] = p % dimensions == 0 ? p / dimensions : 63;
+				compact[p] = p * dimensions < 64 ? p * dimensions : 0;
+			}
+		}
+	};
+
+	static const AVX512Indices& Indices() {
+		static AVX512Indices indices;
+		return indices;
+	}
+
+	__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+	static coord_t DilateAVX512(unscaled_coord_t value) {
+		__m512i bytes = _mm512_maskz_mov_epi8(_cvtu64_mask64(value), _mm512_set1_epi8(-1));
+		bytes = _mm512_permutexvar_epi8(_mm512_load_si512(Indices().dilate), bytes);
+		return _cvtmask64_u64(_mm512_movepi8_mask(bytes));
+	}
+
+	__attribute__((target("avx512f,avx512bw,avx512bitalg")))
+	static unscaled_coord_t CompactAVX512(coord_t x) {
+		const coord_t valid = (HCS_COORD_BITS + dimensions - 1) / dimensions >= 64 ? ~(coord_t)0 : ((coord_t)1 << ((HCS_COORD_BITS + dimensions - 1) / dimensions)) - 1;
+		return _cvtmask64_u64(_mm512_bitshuffle_epi64_mask(_mm512_set1_epi64(x), _mm512_load_si512(Indices().compact))) & valid;
+	}
+#else
+	static coord_t DilatePDEP(unscaled_coord_t value) { return DilateMagic(value); }
+	static unscaled_coord_t CompactPDEP(coord_t x) { return CompactMagic(x); }
+	static coord_t DilateAVX512(unscaled_coord_t value) { return DilateMagic(value); }
+	static unscaled_coord_t CompactAVX512(coord_t x) { return CompactMagic(x); }
+#endif
+};
+
+template<size_t dimensions> constexpr coord_t Morton<dimensions>::dimension_mask;
+template<size_t dimensions> constexpr coord_t Morton<dimensions>::magic_masks[8];
+template<size_t dimensions> coord_t (*Morton<dimensions>::dilate)(unscaled_coord_t) = Morton<dimensions>::DilateMagic;
+template<size_t dimensions> unscaled_coord_t (*Morton<dimensions>::compact)(coord_t) = Morton<dimensions>::CompactMagic;
+template<size_t dimensions> const bool Morton<dimensions>::registered = Morton<dimensions>::Register();
+
+// Curve policies order the 2^D sub-coords of each level. Encode() turns the unscaled position of a cell into the
+// level bits of its coord (no level marker), Decode() reverses it. Every curve keeps the prefix property: without
+// its lowest D bits a coord is its parent cell. So level markers, boundaries, ReduceLevel() / IncreaseLevel() and
+// all fields work the same for any curve.
+// A separable curve changes only the bits of one dimension when moving along it, HCS then uses the successor
+// formula and bit masks. Other curves are decoded, moved and encoded again.
+
+// Z-order, the default: every dimensions-th bit belongs to the same dimension
+template<size_t dimensions>
+struct MortonCurve {
+	static const bool separable = true;
+
+	static coord_t Encode(level_t level, const array<unscaled_coord_t, dimensions>& unscaled) {
+		coord_t result = 0;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			result |= Morton<dimensions>::Dilate(unscaled[dim]) << dim;
+		return LowBits(result, level * dimensions);
+	}
+
+	static array<unscaled_coord_t, dimensions> Decode(level_t level, coord_t bits) {
+		array<unscaled_coord_t, dimensions> result;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			result[dim] = Morton<dimensions>::Compact(bits >> dim);
+		return result;
+	}
+};
+
+// Hilbert order: consecutive coords of a level are always face neighbors, there are no Z-jumps.
+// Uses the transpose form of J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004):
+// The transposed index is Morton interleaved with X as highest bit of each level.
+template<size_t dimensions>
+struct HilbertCurve {
+	static const bool separable = false;
+
+	static coord_t Encode(level_t level, array<unscaled_coord_t, dimensions> x) {
+		if (level == 0)
+			return 0;
+		if (level > Morton<dimensions>::max_bits)
+			level = Morton<dimensions>::max_bits;
+		const unscaled_coord_t m = (unscaled_coord_t)1 << (level - 1);
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			x[dim] &= (m << 1) - 1;
+		// Inverse undo
+		for (unscaled_coord_t q = m; q > 1; q >>= 1) {
+			unscaled_coord_t p = q - 1;
+			for (uint8_t dim = 0; dim < dimensions; dim++) {
+				if (x[dim] & q) {
+					x[0] ^= p;
+				} else {
+					unscaled_coord_t t = (x[0] ^ x[dim]) & p;
+					x[0] ^= t;
+					x[dim] ^= t;
+				}
+			}
+		}
+		// Gray encode
+		for (uint8_t dim = 1; dim < dimensions; dim++)
+			x[dim] ^= x[dim - 1];
+		unscaled_coord_t t = 0;
+		for (unscaled_coord_t q = m; q > 1; q >>= 1)
+			if (x[dimensions - 1] & q)
+				t ^= q - 1;
+		coord_t result = 0;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			result |= Morton<dimensions>::Dilate(x[dim] ^ t) << (dimensions - 1 - dim);
+		return result;
+	}
+
+	static array<unscaled_coord_t, dimensions> Decode(level_t level, coord_t bits) {
+		array<unscaled_coord_t, dimensions> x;
+		if (level == 0) {
+			x.fill(0);
+			return x;
+		}
+		if (level > Morton<dimensions>::max_bits)
+			level = Morton<dimensions>::max_bits;
+		bits = LowBits(bits, level * dimensions);
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			x[dim] = Morton<dimensions>::Compact(bits >> (dimensions - 1 - dim));
+		// Gray decode
+		unscaled_coord_t t = x[dimensions - 1] >> 1;
+		for (uint8_t dim = dimensions - 1; dim > 0; dim--)
+			x[dim] ^= x[dim - 1];
+		x[0] ^= t;
+		// Undo excess work
+		const unscaled_coord_t n = (unscaled_coord_t)1 << (level - 1);
+		for (unscaled_coord_t q = 2; q != 0 && q <= n; q <<= 1) {
+			unscaled_coord_t p = q - 1;
+			for (uint8_t dim = dimensions; dim-- > 0;) {
+				if (x[dim] & q) {
+					x[0] ^= p;
+				} else {
+					unscaled_coord_t s = (x[0] ^ x[dim]) & p;
+					x[0] ^= s;
+					x[dim] ^= s;
+				}
+			}
+		}
+		return x;
+	}
+};
+
+// Compile-time index lists to build the static HCS tables, split in halves to keep the template depth logarithmic
+template<size_t... I> struct IndexList {};
+
+template<class A, class B> struct ConcatIndexList;
+template<size_t... A, size_t... B> struct ConcatIndexList<IndexList<A...>, IndexList<B...> > {
+	typedef IndexList<A..., (sizeof...(A) + B)...> type;
+};
+
+template<size_t N> struct MakeIndexList : ConcatIndexList<typename MakeIndexList<N / 2>::type, typename MakeIndexList<N - N / 2>::type> {};
+template<> struct MakeIndexList<0> { typedef IndexList<> type; };
+template<> struct MakeIndexList<1> { typedef IndexList<0> type; };
+
+// single repeated for levels 0 ... levels - 1
+constexpr coord_t RepeatLevels(size_t dimensions, coord_t single, size_t levels) {
+	return levels == 0 ? 0 : (single << (dimensions * (levels - 1))) | RepeatLevels(dimensions, single, levels - 1);
+}
+
+// Bits that stay untouched when stepping into direction (even: positive, odd: negative)
+constexpr coord_t SuccessorMask(size_t dimensions, size_t direction) {
+	return direction & 1 ? ~SuccessorMask(dimensions, direction - 1) :
+			RepeatLevels(dimensions, ~((coord_t)1 << (direction / 2)) & (((coord_t)1 << dimensions) - 1), MaxBits(dimensions));
+}
+
+template<size_t dimensions, size_t... I>
+constexpr array<coord_t, sizeof...(I)> SuccessorMasks(IndexList<I...>) {
+	return {{ SuccessorMask(dimensions, I)... }};
+}
+
+// All bits of a dimension below the boundary bits
+template<size_t dimensions, size_t... I>
+constexpr array<coord_t, sizeof...(I)> BMIMasks(IndexList<I...>) {
+	return {{ (SuccessorMask(dimensions, 2 * I + 1) & ~(~(coord_t)0 << (HCS_COORD_BITS - dimensions - 1)))... }};
+}
+
+// First and last coord of a level, zero for levels that do not fit into coord_t
+constexpr pair<coord_t, coord_t> LevelBound(size_t dimensions, size_t level) {
+	return level == 0 ? pair<coord_t, coord_t>(1, 1) :
+			level * dimensions + 1 >= HCS_COORD_BITS ? pair<coord_t, coord_t>(0, 0) :
+			pair<coord_t, coord_t>((coord_t)1 << (level * dimensions), ((coord_t)1 << (level * dimensions + 1)) - 1);
+}
+
+template<size_t dimensions, size_t... I>
+constexpr array<pair<coord_t, coord_t>, sizeof...(I)> LevelBounds(IndexList<I...>) {
+	return {{ LevelBound(dimensions, I)... }};
+}
+
+// Weight of an interpolation coeff, index i is described at HCS::weights_lookup
+constexpr data_t InterpolationWeight(size_t dimensions, size_t i, size_t dim = 0) {
+	return dim == dimensions ? 1 :
+			((i >> (dimensions + dim)) & 1 ? 0.5 : (i >> dim) & 1 ? 0.25 : 0.75) * InterpolationWeight(dimensions, i, dim + 1);
+}
+
+constexpr size_t PopCount(size_t x) {
+	return x == 0 ? 0 : (x & 1) + PopCount(x >> 1);
+}
+
+// Weight of slot k in the merged coefficients of a coord with boundary set q, HCS::boundary_weights describes the slots.
+// Adds the getCoeffs2() shares of all corners i in ascending order, the same order getCoeffs2() adds them in.
+constexpr data_t BoundaryWeight(size_t dimensions, size_t q, size_t k, size_t i = 0, data_t sum = 0) {
+	return i == ((size_t)1 << dimensions) ? sum : BoundaryWeight(dimensions, q, k, i + 1, sum + (
+			(k & q) == 0 ? (i == k ? InterpolationWeight(dimensions, (q << dimensions) | i) : 0) :
+			PopCount(k & q) != 1 || (k & ~q) > (k & q) ? 0 :	// one boundary dimension j, all S bits below j
+			(i & k & q) && (i & ~q & ((k & q) - 1)) == (k & ~q) ? InterpolationWeight(dimensions, (q << dimensions) | i) / PopCount(i & q) : 0));
+}
+
+template<size_t dimensions, size_t... I>
+constexpr array<data_t, sizeof...(I)> BoundaryWeights(IndexList<I...>) {
+	return {{ BoundaryWeight(dimensions, I >> dimensions, I & ((1U << dimensions) - 1))... }};
+}
+
+/* INV DIST weighting with p=1 would be 1/sqrt(sum over dims of (bit ? 0.75*0.75 : 0.25*0.25)), 0.25 for any boundary */
+
+template<size_t dimensions, size_t... I>
+constexpr array<data_t, sizeof...(I)> InterpolationWeights(IndexList<I...>) {
+	return {{ InterpolationWeight(dimensions, I)... }};
+}
+
+// A set of (coord, weight) pairs for interpolation, sorted by coord with duplicates merged, that iterates
+// like map<coord_t, data_t>. Up to capacity pairs are stored inline, so building coefficients does not allocate.
+// Sets that grow beyond capacity (deep recursion in Field::getCoeffs()) spill all pairs to the heap.
+template<size_t capacity>
+class CoeffSet {
+public:
+	typedef pair<coord_t, data_t> value_type;
+	typedef value_type* iterator;
+	typedef const value_type* const_iterator;
+
+	CoeffSet() : n(0) {}
+
+	size_t size() const { return n; }
+	bool empty() const { return n == 0; }
+	void clear() { n = 0; heap.clear(); }
+
+	iterator begin() { return data(); }
+	iterator end() { return data() + n; }
+	const_iterator begin() const { return data(); }
+	const_iterator end() const { return data() + n; }
+
+	iterator find(coord_t coord) {
+		iterator it = lowerBound(coord);
+		return it != end() && it->first == coord ? it : end();
+	}
+
+	// Weight of coord, inserted with 0 if not present (like map::operator[])
+	data_t& operator[](coord_t coord) {
+		iterator it = lowerBound(coord);
+		if (it != end() && it->first == coord)
+			return it->second;
+		return insertAt(it - begin(), coord)->second;
+	}
+
+	// Inserts the pairs whose coord is not present yet (like map::insert)
+	template<class IT>
+	void insert(IT first, IT last) {
+		for (; first != last; ++first) {
+			iterator it = lowerBound(first->first);
+			if (it == end() || it->first != first->first)
+				insertAt(it - begin(), first->first)->second = first->second;
+		}
+	}
+
+private:
+	size_t n;
+	typename aligned_storage<sizeof(value_type) * capacity, alignof(value_type)>::type local; // uninitialized, pairs are trivial
+	vector<value_type> heap;	// all pairs, once there are more than capacity
+
+	value_type* data() { return heap.empty() ? (value_type*)&local : &heap[0]; }
+	const value_type* data() const { return heap.empty() ? (const value_type*)&local : &heap[0]; }
+
+	iterator lowerBound(coord_t coord) {
+		iterator it = begin(), last = end();
+		while (it != last && it->first < coord)	// a handful of entries, linear beats binary search
+			++it;
+		return it;
+	}
+
+	iterator insertAt(size_t pos, coord_t coord) {
+		if (n == capacity && heap.empty())
+			heap.assign(begin(), end());
+		if (!heap.empty()) {
+			heap.insert(heap.begin() + pos, value_type(coord, 0));
+			n++;
+			return &heap[pos];
+		}
+		value_type* d = data();
+		copy_backward(d + pos, d + n, d + n + 1);
+		d[pos] = value_type(coord, 0);
+		n++;
+		return d + pos;
+	}
+};
+
 // The H-coordinate system (HCS) class just stores the scaling and position parameters and calculates some other useful stuff.
 // The HCS class does not store data!
 
-template<size_t dimensions = 3>
+// Curve selects the order of the sub-coords within a level, see MortonCurve and HilbertCurve.
+// Bit d of periodic makes dimension d wrap around: neighbors across its ends are the cells on the opposite side,
+// no boundary coords.
+template<size_t dimensions = 3, template<size_t> class Curve = MortonCurve, uint32_t periodic = 0>
 class HCS {
 public:
 
 	HCS() {
-		part_mask = (1U << dimensions) - 1;
-		parts = 1U << dimensions;
 		// Initializes origin + scale
 		for (int d = 0; d < dimensions; d++)
 			center[d] = scales[d] = 0.5;	// makes 1x1x... box from 0-> 1
-		max_level = (HCS_COORD_BITS - 2 - dimensions) / dimensions;
-		boundary_mask = ~(coord_t)0 << (HCS_COORD_BITS - dimensions - 1);
-		for (int d = 0; d < dimensions * 2; d += 2) {
-			coord_t single = ~(1U << (d / 2)) & part_mask;
-			successor_mask[d] = single;
-			for (level_t l = 1; l < max_level; l++)
-				successor_mask[d] |= single << (dimensions * l);
-			successor_mask[d + 1] = ~successor_mask[d];
-			bmi_mask[d >> 1] = successor_mask[d+1] & ~boundary_mask;
-
-		}
-		level_bounds[0].first = level_bounds[0].second = 1;
-
-		for (int l = 1; l < level_bounds.size(); l++) {
-			level_bounds[l].first = CreateMinLevel(l);
-			level_bounds[l].second = CreateMaxLevel(l);
-		}
-
-		// Pre-compute weights. The index of this array is a bit-mask:
-		// 3D example MSB->LSB:
-		// Z-direction boundary?, Y-direction boundary?, X-direction boundary?, Z-bit, Y-bit, X-bit = 6 bit, 64 value lookup.
-		for (uint32_t i = 0; i < 1U << (dimensions * 2); i++) {
-		    bitset<8> boundary_part(i >> dimensions);
-		    bitset<8> coord_part(i & part_mask);
-
-		    data_t weight = 1;
-            for (uint32_t j = 0; j < dimensions; j++)
-                if (boundary_part[j])
-                    weight *= 0.5;
-                else
-                    weight *= ((i >> j) & 1) ? 0.25 : 0.75;
-            weights_lookup[i] = weight;
-
-		    /* INV DIST weighting with p=1
-		    data_t weight = 0;
-            for (uint32_t j = 0; j < dimensions; j++)
-                if (boundary_part[j])
-                    weight = 0.25;
-                else
-                    weight += ((i >> j) & 1) ? 0.75*0.75 : 0.25*0.25;
-            weights_lookup[i] = 1./(sqrt(weight));
-            */
-    	}
-
 	}
 
 	// A type to store a Cartesian position
 	typedef array<data_t, dimensions> pos_t;
-	typedef array<uint32_t, dimensions> unscaled_t; // and the raw morton->Cartesian coords
+	typedef array<unscaled_coord_t, dimensions> unscaled_t; // and the raw curve->Cartesian coords
+	typedef Curve<dimensions> curve;
 
 	pos_t center;
 	pos_t scales;
 
-	coord_t part_mask;  // A bit mask that covers a single level
-	level_t parts;		// How many directions has a single level (nodes on the H)
+	// Everything below is computed at compile time and shared by all instances of a dimension,
+	// an HCS object only holds center and scales.
+	static constexpr coord_t part_mask = (1U << dimensions) - 1;  // A bit mask that covers a single level
+	static constexpr level_t parts = 1U << dimensions;		// How many directions has a single level (nodes on the H)
 
-	coord_t boundary_mask; // masks all bits representing boundary information
-	level_t max_level;	// The highest recursion depth (level) of this setup
+	static constexpr coord_t boundary_mask = ~(coord_t)0 << (HCS_COORD_BITS - dimensions - 1); // masks all bits representing boundary information
+	static constexpr level_t max_level = MaxBits(dimensions);	// The highest recursion depth (level) of this setup
 
 	// Masks to quickly find neighbors
-	array<coord_t, dimensions * 2> successor_mask;
-	array<coord_t, dimensions> bmi_mask;
-
-	array<pair<coord_t, coord_t>, 64> level_bounds; // min-max pair of coords for each level
-    array<data_t, 1U << (dimensions * 2)> weights_lookup; // pre-computed weights for interpolation coeffs
+	static constexpr array<coord_t, dimensions * 2> successor_mask = SuccessorMasks<dimensions>(typename MakeIndexList<dimensions * 2>::type());
+	static constexpr array<coord_t, dimensions> bmi_mask = BMIMasks<dimensions>(typename MakeIndexList<dimensions>::type());
+
+	static constexpr array<pair<coord_t, coord_t>, HCS_COORD_BITS> level_bounds = LevelBounds<dimensions>(typename MakeIndexList<HCS_COORD_BITS>::type()); // min-max pair of coords for each level
+	// Pre-computed weights for interpolation coeffs. The index of this array is a bit-mask:
+	// 3D example MSB->LSB:
+	// Z-direction boundary?, Y-direction boundary?, X-direction boundary?, Z-bit, Y-bit, X-bit = 6 bit, 64 value lookup.
+	static constexpr array<data_t, 1U << (dimensions * 2)> weights_lookup = InterpolationWeights<dimensions>(typename MakeIndexList<1U << (dimensions * 2)>::type());
+	// Merged weights of coords near more than one boundary, index is boundary set q << dimensions | slot k.
+	// Slot k with k & q == 0 is the interior coord origin moved along the dimensions of k. Slot k with a single
+	// boundary dimension j = k & q and S = k & ~q below j is the boundary j hit from origin moved along S.
+	// Zero for slots that do not exist.
+	static constexpr array<data_t, 1U << (dimensions * 2)> boundary_weights = BoundaryWeights<dimensions>(typename MakeIndexList<1U << (dimensions * 2)>::type());
 
 	// Test for most-significant bit
 	static bool IsBoundary(coord_t coord) {
@@ -185,10 +726,34 @@ public:
 		return (coord << (dimensions + 1)) >> (dimensions + 1);
 	}
 
+	static bool IsPeriodic(uint8_t dim) {
+		return (periodic >> dim) & 1;
+	}
+
+	// u is an unscaled component of dim after a move, max_coord the number of cells per dimension of its level.
+	// Wraps u around for periodic dimensions, otherwise returns false if u left the domain.
+	static bool Wrap(unscaled_coord_t &u, uint8_t dim, unscaled_coord_t max_coord) {
+		if (IsPeriodic(dim)) {
+			u &= max_coord - 1;
+			return true;
+		}
+		return u < max_coord;
+	}
+
 	// Return neighbor for a certain direction. 0=X+, 1=X-, 2=Y+, 3=Y-,...
 	// This uses overflow arithmetic, aka the successor formula
 	// https://en.wikipedia.org/wiki/Moser%E2%80%93de_Bruijn_sequence
+	// Curves that are not separable move the decoded position instead.
 	coord_t getNeighbor(coord_t coord, uint8_t direction) {
+		if (!curve::separable) {
+			level_t level = GetLevel(coord);
+			unscaled_t unscaled = curve::Decode(level, RemoveLevel(coord, level));
+			unscaled_coord_t &u = unscaled[direction >> 1];
+			u += direction & 1 ? -1 : 1;
+			if (Wrap(u, direction >> 1, (unscaled_coord_t)1 << level))
+				return CreateMinLevel(level) | curve::Encode(level, unscaled);
+			return coord | ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+		}
 		coord_t s_mask = successor_mask[direction];
 		coord_t result = 0;
 		if (direction & 1) { // negative direction
@@ -204,6 +769,12 @@ public:
 		if (__count_leading_zeros(coord) == __count_leading_zeros(result))
 			return result;
 
+		// The carry / borrow left the level, below the level marker the bits of the dimension already wrapped around
+		if (IsPeriodic(direction >> 1)) {
+			coord_t level_mask = ((coord_t)1 << GetLevelBitPosition(coord)) - 1;
+			return (result & level_mask) | (coord & ~level_mask);
+		}
+
 		// Mark result as boundary
 		result = coord;
 		result |= (coord_t)1 << (HCS_COORD_BITS - 1);
@@ -212,37 +783,281 @@ public:
 		return result;
 	}
 
-	// Alternative approach using unscaled Cartesian coords. On systems with BMI2 instructions,
-	// this is on-par with original. Same result as getNeighbor()
-	coord_t getNeighbor2(coord_t coord, uint8_t direction) {
-#ifdef __BMI2__
-		level_t bit_pos = GetLevelBitPosition(coord);
-		coord_t mask = _bzhi_u64(bmi_mask[direction >> 1], bit_pos);
-		uint32_t unscaled =  _pext_u64(coord, mask);
-		unscaled += direction & 1 ? -1 : 1;
-
-		if (unscaled >= 1U << (bit_pos / dimensions)) {
-			coord |= (coord_t)1 << (HCS_COORD_BITS - 1);
-			coord |= (coord_t)direction << (HCS_COORD_BITS - 2);
-		} else {
-			coord &= ~mask; // clear bits for dim while leaving level bits untouched
-			coord |=  _pdep_u64(unscaled, mask);
+	// Batched getNeighbor() for n coords, all in the same direction. Results are identical to getNeighbor(),
+	// boundary marking included. in and out may point to the same array.
+	// With AVX-512 8 coords (AVX2: 4) are processed per step, the rest goes through getNeighbor().
+	// The boundary test compares the level-marker positions of coord and result like getNeighbor() does with
+	// __count_leading_zeros(): the highest set bit of a and b is the same if (a ^ b) < (a & b).
+	void getNeighbors(const coord_t* in, size_t n, uint8_t direction, coord_t* out) {
+		size_t i = 0;
+		const size_t n_simd = curve::separable ? n : 0;	// other curves only through getNeighbor()
+		coord_t s_mask = successor_mask[direction];
+		coord_t boundary_bits = ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+#if defined(HCS_SIMD) && defined(__AVX512F__)
+		const __m512i v_mask = _mm512_set1_epi64(s_mask);
+		const __m512i v_one = _mm512_set1_epi64(1);
+		const __m512i v_boundary = _mm512_set1_epi64(boundary_bits);
+		for (; i + 8 <= n_simd; i += 8) {
+			__m512i coord = _mm512_loadu_si512((const void*)(in + i));
+			__m512i result;
+			if (direction & 1) { // negative direction
+				result = _mm512_and_si512(_mm512_sub_epi64(_mm512_and_si512(coord, v_mask), v_one), v_mask);
+				result = _mm512_or_si512(result, _mm512_andnot_si512(v_mask, coord));
+			} else {
+				result = _mm512_andnot_si512(v_mask, _mm512_add_epi64(_mm512_or_si512(coord, v_mask), v_one));
+				result = _mm512_or_si512(result, _mm512_and_si512(v_mask, coord));
+			}
+			__mmask8 inside = _mm512_cmplt_epu64_mask(_mm512_xor_si512(coord, result), _mm512_and_si512(coord, result));
+			result = _mm512_mask_blend_epi64(inside, _mm512_or_si512(coord, v_boundary), result);
+			if (IsPeriodic(direction >> 1) && inside != 0xff) { // the lanes at the ends wrap around one by one
+				alignas(64) coord_t lanes[8];
+				_mm512_store_si512((void*)lanes, coord);
+				for (int lane = 0; lane < 8; lane++)
+					if (!((inside >> lane) & 1))
+						lanes[lane] = getNeighbor(lanes[lane], direction);
+				result = _mm512_mask_blend_epi64(inside, _mm512_load_si512((const void*)lanes), result);
+			}
+			_mm512_storeu_si512((void*)(out + i), result);
 		}
-		return coord;
-#else
+#elif defined(HCS_SIMD) && defined(__AVX2__)
+		const __m256i v_mask = _mm256_set1_epi64x(s_mask);
+		const __m256i v_one = _mm256_set1_epi64x(1);
+		const __m256i v_boundary = _mm256_set1_epi64x(boundary_bits);
+		const __m256i v_sign = _mm256_set1_epi64x((coord_t)1 << (HCS_COORD_BITS - 1)); // AVX2 only compares signed
+		for (; i + 4 <= n_simd; i += 4) {
+			__m256i coord = _mm256_loadu_si256((const __m256i*)(in + i));
+			__m256i result;
+			if (direction & 1) { // negative direction
+				result = _mm256_and_si256(_mm256_sub_epi64(_mm256_and_si256(coord, v_mask), v_one), v_mask);
+				result = _mm256_or_si256(result, _mm256_andnot_si256(v_mask, coord));
+			} else {
+				result = _mm256_andnot_si256(v_mask, _mm256_add_epi64(_mm256_or_si256(coord, v_mask), v_one));
+				result = _mm256_or_si256(result, _mm256_and_si256(v_mask, coord));
+			}
+			__m256i lhs = _mm256_xor_si256(_mm256_xor_si256(coord, result), v_sign);
+			__m256i rhs = _mm256_xor_si256(_mm256_and_si256(coord, result), v_sign);
+			__m256i inside = _mm256_cmpgt_epi64(rhs, lhs);
+			result = _mm256_blendv_epi8(_mm256_or_si256(coord, v_boundary), result, inside);
+			int inside_lanes = _mm256_movemask_pd(_mm256_castsi256_pd(inside));
+			if (IsPeriodic(direction >> 1) && inside_lanes != 0xf) { // the lanes at the ends wrap around one by one
+				alignas(32) coord_t lanes[4];
+				_mm256_store_si256((__m256i*)lanes, coord);
+				for (int lane = 0; lane < 4; lane++)
+					if (!((inside_lanes >> lane) & 1))
+						lanes[lane] = getNeighbor(lanes[lane], direction);
+				result = _mm256_blendv_epi8(_mm256_load_si256((const __m256i*)lanes), result, inside);
+			}
+			_mm256_storeu_si256((__m256i*)(out + i), result);
+		}
+#endif
+		for (; i < n; i++)
+			out[i] = getNeighbor(in[i], direction);
+	}
 
-		uint32_t unscaled = getSingleUnscaled(coord, direction >> 1);
+	// Alternative approach using unscaled Cartesian coords. On systems with fast BMI2 instructions,
+	// this is on-par with original. Same result as getNeighbor()
+	coord_t getNeighbor2(coord_t coord, uint8_t direction) {
+		unscaled_coord_t unscaled = getSingleUnscaled(coord, direction >> 1);
 		level_t l = GetLevel(coord);
-		uint32_t max_coord = (1U << l);
+		unscaled_coord_t max_coord = (unscaled_coord_t)1 << l;
 		unscaled += direction & 1 ? -1 : 1;
-		if (unscaled >= max_coord) {
+		if (!Wrap(unscaled, direction >> 1, max_coord)) {
 			coord |= (coord_t)1 << (HCS_COORD_BITS - 1);
-			coord |= (coord_t)direction << (HCS_COORD_BITS - 2);
+			coord |= (coord_t)direction << (HCS_COORD_BITS - 1 - dimensions);
 		} else {
 			setSingleUnscaled(coord, l, direction >> 1, unscaled);
 		}
 		return coord;
-#endif
+	}
+
+	// All face neighbors of coord in one call, result[direction] == getNeighbor(coord, direction).
+	// Level and unscaled position are extracted once and shared by all directions.
+	array<coord_t, dimensions * 2> getNeighborhood(coord_t coord) {
+		array<coord_t, dimensions * 2> result;
+		level_t level = GetLevel(coord);
+		unscaled_t unscaled = getUnscaled(coord);
+		unscaled_coord_t max_coord = (unscaled_coord_t)1 << level;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			for (uint8_t negative = 0; negative < 2; negative++) {
+				uint8_t direction = 2 * dim + negative;
+				unscaled_coord_t u = negative ? unscaled[dim] - 1 : unscaled[dim] + 1;
+				coord_t &ne = result[direction];
+				ne = coord;
+				if (!Wrap(u, dim, max_coord)) {
+					ne |= ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+				} else if (curve::separable) {
+					setSingleUnscaled(ne, level, dim, u);
+				} else {
+					unscaled_t moved = unscaled;
+					moved[dim] = u;
+					ne = CreateMinLevel(level) | curve::Encode(level, moved);
+				}
+			}
+		return result;
+	}
+
+	// The full Moore neighborhood of coord (3^D - 1 coords, including diagonals), decoded once.
+	// Entry i describes the offset with base-3 digits of i (center skipped, so i >= (3^D - 1) / 2 is shifted by one),
+	// digit d (dimension d, X is least significant) being 0 = minus, 1 = none, 2 = plus.
+	// Face neighbors are identical to getNeighbor(). If an offset leaves the domain, the entry is marked as boundary
+	// for the lowest leaving dimension, carrying the coord moved along all remaining (inside) dimensions as origin.
+	// This is what chaining getNeighbor() over the dimensions gives when the boundary coords are not followed.
+	array<coord_t, Pow3(dimensions) - 1> getMooreNeighborhood(coord_t coord) {
+		array<coord_t, Pow3(dimensions) - 1> result;
+		level_t level = GetLevel(coord);
+		const size_t center = (Pow3(dimensions) - 1) / 2;
+
+		if (!curve::separable) { // every entry encoded on its own
+			unscaled_t unscaled = getUnscaled(coord);
+			unscaled_coord_t max_coord = (unscaled_coord_t)1 << level;
+			for (size_t i = 0; i < result.size(); i++) {
+				size_t idx = i < center ? i : i + 1;
+				unscaled_t moved = unscaled;
+				int8_t boundary_direction = -1;
+				for (uint8_t dim = 0; dim < dimensions; dim++, idx /= 3) {
+					unscaled_coord_t u = unscaled[dim] + idx % 3 - 1;
+					if (Wrap(u, dim, max_coord))
+						moved[dim] = u;
+					else if (boundary_direction < 0)
+						boundary_direction = 2 * dim + (idx % 3 == 0);
+				}
+				result[i] = CreateMinLevel(level) | curve::Encode(level, moved);
+				if (boundary_direction >= 0)
+					result[i] |= BoundaryMark(boundary_direction);
+			}
+			return result;
+		}
+
+		// The bits of every dimension for the three offsets. Within the bits of one dimension a step is a masked
+		// increment / decrement (no decoding); plus wraps to 0 and minus starts from 0 at the edge of the domain.
+		// Offsets leaving the domain keep the own bits and get the boundary marking in flags. The level marker is
+		// kept in rest.
+		coord_t rest = coord;
+		coord_t parts[dimensions][3], flags[dimensions][3];
+		for (uint8_t dim = 0; dim < dimensions; dim++) {
+			coord_t mask = RemoveLevel(bmi_mask[dim], level);
+			coord_t own = coord & mask;
+			coord_t plus = ((own | ~mask) + 1) & mask;
+			bool minus_outside = own == 0 && !IsPeriodic(dim), plus_outside = plus == 0 && !IsPeriodic(dim);
+			rest &= ~mask;
+			parts[dim][0] = minus_outside ? own : (own - 1) & mask;
+			parts[dim][1] = own;
+			parts[dim][2] = plus_outside ? own : plus;
+			flags[dim][0] = minus_outside ? BoundaryMark(2 * dim + 1) : 0;
+			flags[dim][1] = 0;
+			flags[dim][2] = plus_outside ? BoundaryMark(2 * dim) : 0;
+		}
+		MooreExpand(&result[0], rest, 0, parts, flags, integral_constant<int, dimensions - 1>(), integral_constant<size_t, 0>());
+		return result;
+	}
+
+	// Writes the entries of getMooreNeighborhood() below the digits IDX of the dimensions above DIM, unrolled at
+	// compile time. The flag of a lower dimension replaces the one of a higher, the lowest leaving dimension wins.
+	template <int DIM, size_t IDX>
+	static inline __attribute__((always_inline)) void MooreExpand(coord_t* out, coord_t ne, coord_t flag,
+			const coord_t (&parts)[dimensions][3], const coord_t (&flags)[dimensions][3], integral_constant<int, DIM>, integral_constant<size_t, IDX>) {
+		MooreExpand(out, ne | parts[DIM][0], flags[DIM][0] ? flags[DIM][0] : flag, parts, flags, integral_constant<int, DIM - 1>(), integral_constant<size_t, IDX * 3>());
+		MooreExpand(out, ne | parts[DIM][1], flag, parts, flags, integral_constant<int, DIM - 1>(), integral_constant<size_t, IDX * 3 + 1>());
+		MooreExpand(out, ne | parts[DIM][2], flags[DIM][2] ? flags[DIM][2] : flag, parts, flags, integral_constant<int, DIM - 1>(), integral_constant<size_t, IDX * 3 + 2>());
+	}
+
+	template <size_t IDX>
+	static inline __attribute__((always_inline)) void MooreExpand(coord_t* out, coord_t ne, coord_t flag,
+			const coord_t (&)[dimensions][3], const coord_t (&)[dimensions][3], integral_constant<int, -1>, integral_constant<size_t, IDX>) {
+		const size_t center = (Pow3(dimensions) - 1) / 2;
+		if (IDX != center)
+			out[IDX < center ? IDX : IDX - 1] = ne | flag;
+	}
+
+	// The high bits getNeighbor() sets when direction leaves the domain
+	static constexpr coord_t BoundaryMark(uint8_t direction) {
+		return ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+	}
+
+	// A coord together with its level and unscaled position, for line sweeps and stencil walks.
+	// Moves only change the unscaled position, the coord is encoded once when it is read. On a separable curve
+	// only the dimensions moved since the last read are encoded again.
+	// child(part) takes the upper half along dimension j if bit j of part is set, for Morton that is
+	// IncreaseLevel(coord, part). Boundary coords cannot be walked, steps out of the domain are refused.
+	class Cursor {
+	public:
+		Cursor(coord_t coord) : level(GetLevel(coord)), encoded(coord), dirty(0) {
+			unscaled = curve::Decode(level, RemoveLevel(coord, level));
+		}
+
+		Cursor(level_t level_, const unscaled_t& unscaled_) : level(level_), unscaled(unscaled_), encoded(0), dirty(all_dirty) {}
+
+		coord_t coord() const {
+			if (dirty == 0)
+				return encoded;
+			if (curve::separable && dirty != all_dirty) {
+				for (uint8_t dim = 0; dim < dimensions; dim++)
+					if ((dirty >> dim) & 1) {
+						coord_t mask = RemoveLevel(bmi_mask[dim], level);
+						encoded = (encoded & ~mask) | ((Morton<dimensions>::Dilate(unscaled[dim]) << dim) & mask);
+					}
+			} else {
+				encoded = CreateMinLevel(level) | curve::Encode(level, unscaled);
+			}
+			dirty = 0;
+			return encoded;
+		}
+
+		level_t getLevel() const {
+			return level;
+		}
+
+		const unscaled_t& getUnscaled() const {
+			return unscaled;
+		}
+
+		// Move to the neighbor in direction (0=X+, 1=X-,...), returns false and stays if that is a boundary
+		bool step(uint8_t direction) {
+			unscaled_coord_t u = unscaled[direction >> 1] + (direction & 1 ? -1 : 1);
+			if (!Wrap(u, direction >> 1, (unscaled_coord_t)1 << level))
+				return false;
+			unscaled[direction >> 1] = u;
+			dirty |= 1U << (direction >> 1);
+			return true;
+		}
+
+		// The same coord as getNeighbor(coord(), direction), boundaries included, without moving
+		coord_t neighbor(uint8_t direction) const {
+			unscaled_t moved = unscaled;
+			unscaled_coord_t &u = moved[direction >> 1];
+			u += direction & 1 ? -1 : 1;
+			if (!Wrap(u, direction >> 1, (unscaled_coord_t)1 << level))
+				return coord() | ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+			return CreateMinLevel(level) | curve::Encode(level, moved);
+		}
+
+		// Like ReduceLevel(), the center stays
+		void parent() {
+			if (level == 0)
+				return;
+			level--;
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				unscaled[dim] >>= 1;
+			dirty = all_dirty;
+		}
+
+		void child(uint8_t part) {
+			level++;
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				unscaled[dim] = (unscaled[dim] << 1) | ((part >> dim) & 1);
+			dirty = all_dirty;
+		}
+
+	private:
+		static const uint32_t all_dirty = ~0U;	// the level changed, encode everything
+		level_t level;
+		unscaled_t unscaled;
+		mutable coord_t encoded;	// coord of level and unscaled, except for the dirty dimensions (bit mask)
+		mutable uint32_t dirty;
+	};
+
+	Cursor getCursor(coord_t coord) {
+		return Cursor(coord);
 	}
 
 	// Returns a normal vector for the provided direction
@@ -253,7 +1068,7 @@ public:
 	}
 
 	data_t getDistance(coord_t coord, uint8_t direction) {
-		return (2 * scales[direction]) / data_t(1U << GetLevel(coord));
+		return (2 * scales[direction]) / data_t((unscaled_coord_t)1 << GetLevel(coord));
 	}
 
 	// Returns the iteration level of this coordinate. Higher level coordinates are more dense.
@@ -271,27 +1086,18 @@ private:
 	// Returns the original position of the level marker.
 	static inline level_t RemoveLevel(coord_t &coord) {
 		level_t bit_pos = GetLevelBitPosition(coord);
-#ifdef __BMI2__
-		coord = _bzhi_u64(coord, bit_pos);
-#else
-		coord = coord & ((1U << bit_pos ) - 1);
-#endif
+		coord = LowBits(coord, bit_pos);
 		return bit_pos;
 	}
 
 	// ... like above but leave origin intact
 	static inline coord_t RemoveLevel(coord_t coord, level_t level) {
-#ifdef __BMI2__
-		coord = _bzhi_u64(coord, level * dimensions);
-#else
-		coord = coord & ((1U << level * dimensions) - 1);
-#endif
-		return coord;
+		return LowBits(coord, level * dimensions);
 	}
 
 	// Set the level-marker bit of a floating coordinate. NEVER use on a proper coord.
 	static void SetLevel(coord_t &coord, level_t level) {
-		coord_t level_bit = 1U << (level * dimensions);
+		coord_t level_bit = (coord_t)1 << (level * dimensions);
 		coord |= level_bit;
 	}
 
@@ -320,6 +1126,18 @@ public:
 		return (coord >> (dimensions * level)) & part_mask;
 	}
 
+	// Bit j is set if coord lies in the upper half of its parent along dimension j.
+	// That is the highest sub-coord for Morton, other curves need the unscaled position.
+	uint16_t getHighPart(coord_t coord) {
+		if (curve::separable)
+			return extract(coord, 0);
+		unscaled_t unscaled = getUnscaled(coord);
+		uint16_t result = 0;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			result |= (unscaled[dim] & 1) << dim;
+		return result;
+	}
+
 	// Returns Cartesian position.
 	pos_t getPosition(coord_t coord) {
 		pos_t result = center;
@@ -332,7 +1150,7 @@ public:
 			return;
 		unscaled_t unscaled = getUnscaled(coord);
 		level_t level = GetLevel(coord);
-		data_t scale_divisor = 1./ data_t(1 << level);
+		data_t scale_divisor = 1./ data_t((unscaled_coord_t)1 << level);
 		for (uint8_t dim = 0; dim < dimensions; dim++)
 			result[dim] = scales[dim] * ((data_t)unscaled[dim] * scale_divisor * 2 + scale_divisor) - center[dim] + scales[dim];
 	}
@@ -340,12 +1158,163 @@ public:
 	// Returns the coordinate closest to the provided Cart. coordinates for specific level
 	coord_t createFromPosition(level_t level, pos_t pos) {
 		unscaled_t unscaled;
-		data_t scale_divisor = data_t(1 << level);
+		data_t scale_divisor = data_t((unscaled_coord_t)1 << level);
 		for (uint8_t dim = 0; dim < dimensions; dim++)
 			unscaled[dim] = floor(((pos[dim] - center[dim]) / (scales[dim] * 2) + 0.5) * scale_divisor);
 		return createFromUnscaled(level, unscaled);
 	}
 
+	// Batched createFromPosition() for n positions, all at the same level. Same results as the single version.
+	// Scaling, floor and dilation run in AVX-512 / AVX2 lanes if available, data_t is double and the curve separable.
+	void createFromPositions(level_t level, const pos_t* pos, size_t n, coord_t* out) {
+		array<const data_t*, dimensions> components;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			components[dim] = (const data_t*)pos + dim;
+		createFromPositions(level, components, dimensions, n, out);
+	}
+
+	// ... same for a structure of arrays, pos[dim][i] is component dim of position i
+	void createFromPositions(level_t level, const array<const data_t*, dimensions>& pos, size_t n, coord_t* out) {
+		createFromPositions(level, pos, 1, n, out);
+	}
+
+	// Batched getPosition() for n coords of arbitrary levels
+	void getPositions(const coord_t* in, size_t n, pos_t* out) {
+		array<data_t*, dimensions> components;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			components[dim] = (data_t*)out + dim;
+		getPositions(in, n, components, dimensions);
+	}
+
+	// ... same for a structure of arrays, out[dim][i] is component dim of the position of in[i]
+	void getPositions(const coord_t* in, size_t n, const array<data_t*, dimensions>& out) {
+		getPositions(in, n, out, 1);
+	}
+
+private:
+	// The batch kernels, stride is the distance between two positions in data_t units (1 for SoA, dimensions for AoS)
+	void createFromPositions(level_t level, const array<const data_t*, dimensions>& pos, size_t stride, size_t n, coord_t* out) {
+		size_t i = 0;
+		const data_t scale_divisor = data_t((unscaled_coord_t)1 << level);
+		const coord_t level_bit = CreateMinLevel(level);
+#if defined(HCS_SIMD) && defined(__AVX512F__)
+		if (is_same<data_t, double>::value && curve::separable) {
+			const __m512i v_index = _mm512_set_epi64(7 * stride, 6 * stride, 5 * stride, 4 * stride, 3 * stride, 2 * stride, stride, 0);
+			for (; i + 8 <= n; i += 8) {
+				__m512i result = _mm512_setzero_si512();
+				for (uint8_t dim = 0; dim < dimensions; dim++) {
+					const double* p = (const double*)pos[dim] + i * stride;
+					__m512d x = stride == 1 ? _mm512_loadu_pd(p) : _mm512_i64gather_pd(v_index, p, 8);
+					x = _mm512_div_pd(_mm512_sub_pd(x, _mm512_set1_pd(center[dim])), _mm512_set1_pd(scales[dim] * 2));
+					x = _mm512_mul_pd(_mm512_add_pd(x, _mm512_set1_pd(0.5)), _mm512_set1_pd(scale_divisor));
+					x = _mm512_roundscale_pd(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+					__m512i unscaled = _mm512_cvtepi32_epi64(_mm512_cvttpd_epi32(x));
+					result = _mm512_or_si512(result, _mm512_sll_epi64(Morton<dimensions>::Dilate(unscaled), _mm_cvtsi32_si128(dim)));
+				}
+				result = _mm512_and_si512(result, _mm512_set1_epi64(level_bit - 1));
+				_mm512_storeu_si512((void*)(out + i), _mm512_or_si512(result, _mm512_set1_epi64(level_bit)));
+			}
+		}
+#elif defined(HCS_SIMD) && defined(__AVX2__)
+		if (is_same<data_t, double>::value && curve::separable) {
+			const __m256i v_index = _mm256_set_epi64x(3 * stride, 2 * stride, stride, 0);
+			for (; i + 4 <= n; i += 4) {
+				__m256i result = _mm256_setzero_si256();
+				for (uint8_t dim = 0; dim < dimensions; dim++) {
+					const double* p = (const double*)pos[dim] + i * stride;
+					__m256d x = stride == 1 ? _mm256_loadu_pd(p) : _mm256_i64gather_pd(p, v_index, 8);
+					x = _mm256_div_pd(_mm256_sub_pd(x, _mm256_set1_pd(center[dim])), _mm256_set1_pd(scales[dim] * 2));
+					x = _mm256_mul_pd(_mm256_add_pd(x, _mm256_set1_pd(0.5)), _mm256_set1_pd(scale_divisor));
+					__m256i unscaled = _mm256_cvtepi32_epi64(_mm256_cvttpd_epi32(_mm256_floor_pd(x)));
+					result = _mm256_or_si256(result, _mm256_sll_epi64(Morton<dimensions>::Dilate(unscaled), _mm_cvtsi32_si128(dim)));
+				}
+				result = _mm256_and_si256(result, _mm256_set1_epi64x(level_bit - 1));
+				_mm256_storeu_si256((__m256i*)(out + i), _mm256_or_si256(result, _mm256_set1_epi64x(level_bit)));
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			pos_t p;
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				p[dim] = pos[dim][i * stride];
+			out[i] = createFromPosition(level, p);
+		}
+	}
+
+	void getPositions(const coord_t* in, size_t n, const array<data_t*, dimensions>& out, size_t stride) {
+		size_t i = 0;
+#if defined(HCS_SIMD) && defined(__AVX512F__)
+		if (is_same<data_t, double>::value && curve::separable) {
+			const __m512i v_index = _mm512_set_epi64(7 * stride, 6 * stride, 5 * stride, 4 * stride, 3 * stride, 2 * stride, stride, 0);
+			const __m512i v_one = _mm512_set1_epi64(1);
+			for (; i + 8 <= n; i += 8) {
+				__m512i coord = _mm512_loadu_si512((const void*)(in + i));
+				__mmask8 inner = _mm512_cmpgt_epi64_mask(coord, v_one); // not center, not boundary (sign bit)
+#if defined(__AVX512CD__)
+				__m512i bit_pos = _mm512_sub_epi64(_mm512_set1_epi64(HCS_COORD_BITS - 1), _mm512_lzcnt_epi64(coord));
+#else
+				alignas(64) uint64_t bit_pos_[8];
+				for (int lane = 0; lane < 8; lane++)
+					bit_pos_[lane] = in[i + lane] > 1 ? GetLevelBitPosition(in[i + lane]) : 0;
+				__m512i bit_pos = _mm512_load_si512(bit_pos_);
+#endif
+				// level = bit_pos / dimensions, exact with a fixed-point reciprocal for bit positions below 64
+				__m512i level = _mm512_srli_epi64(_mm512_mullo_epi32(bit_pos, _mm512_set1_epi64((65535 + dimensions) / dimensions)), 16);
+				__m512i removed = _mm512_and_si512(coord, _mm512_sub_epi64(_mm512_sllv_epi64(v_one, bit_pos), v_one));
+				// 1 / 2^level built from the exponent bits
+				__m512d scale_divisor = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_sub_epi64(_mm512_set1_epi64(1023), level), 52));
+				for (uint8_t dim = 0; dim < dimensions; dim++) {
+					__m512i unscaled = Morton<dimensions>::Compact(_mm512_srl_epi64(removed, _mm_cvtsi32_si128(dim)));
+					__m512d x = _mm512_cvtepu32_pd(_mm512_cvtepi64_epi32(unscaled));
+					x = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(x, scale_divisor), _mm512_set1_pd(2)), scale_divisor);
+					x = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(_mm512_set1_pd(scales[dim]), x), _mm512_set1_pd(center[dim])), _mm512_set1_pd(scales[dim]));
+					x = _mm512_mask_blend_pd(inner, _mm512_set1_pd(center[dim]), x);
+					double* p = (double*)out[dim] + i * stride;
+					if (stride == 1)
+						_mm512_storeu_pd(p, x);
+					else
+						_mm512_i64scatter_pd(p, v_index, x, 8);
+				}
+			}
+		}
+#elif defined(HCS_SIMD) && defined(__AVX2__)
+		if (is_same<data_t, double>::value && curve::separable) {
+			const __m256i v_one = _mm256_set1_epi64x(1);
+			const __m256i v_low_halves = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+			for (; i + 4 <= n; i += 4) {
+				alignas(32) uint64_t bit_pos_[4];
+				alignas(32) double scale_divisor_[4];
+				alignas(32) double x_[4];
+				bool inner[4];
+				for (int lane = 0; lane < 4; lane++) {
+					inner[lane] = !IsBoundary(in[i + lane]) && in[i + lane] > 1;
+					bit_pos_[lane] = inner[lane] ? GetLevelBitPosition(in[i + lane]) : 0;
+					scale_divisor_[lane] = 1. / data_t((unscaled_coord_t)1 << (bit_pos_[lane] / dimensions));
+				}
+				__m256i coord = _mm256_loadu_si256((const __m256i*)(in + i));
+				__m256i removed = _mm256_and_si256(coord, _mm256_sub_epi64(_mm256_sllv_epi64(v_one, _mm256_load_si256((const __m256i*)bit_pos_)), v_one));
+				__m256d scale_divisor = _mm256_load_pd(scale_divisor_);
+				for (uint8_t dim = 0; dim < dimensions; dim++) {
+					__m256i unscaled = Morton<dimensions>::Compact(_mm256_srl_epi64(removed, _mm_cvtsi32_si128(dim)));
+					__m256d x = _mm256_cvtepi32_pd(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(unscaled, v_low_halves)));
+					x = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(x, scale_divisor), _mm256_set1_pd(2)), scale_divisor);
+					x = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(scales[dim]), x), _mm256_set1_pd(center[dim])), _mm256_set1_pd(scales[dim]));
+					_mm256_store_pd(x_, x);
+					for (int lane = 0; lane < 4; lane++)
+						out[dim][(i + lane) * stride] = inner[lane] ? x_[lane] : center[dim];
+				}
+			}
+		}
+#endif
+		for (; i < n; i++) {
+			pos_t p = getPosition(in[i]);
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				out[dim][i * stride] = p[dim];
+		}
+	}
+
+public:
+
 	// create a coord from a sub-coordinate list (a sub-coord is between 0 and (2^dimension)-1, aka parts)
 	// Example: coord_t my_lower_left_third_level_coord = createFromList({0,0,0});
 	coord_t createFromList(initializer_list<uint8_t> sub_coords) {
@@ -369,78 +1338,100 @@ public:
 	// In contrast, scaled coords are always floats between 0 and 1.
 	// Inspired by https://github.com/Forceflow/libmorton/
 	coord_t createFromUnscaled(level_t level, unscaled_t cart_coord) {
-		coord_t result = 0;
-#ifdef __BMI2__
-		for (uint8_t dim = 0; dim < dimensions; dim++)
-			result |=  _pdep_u64(cart_coord[dim], RemoveLevel(bmi_mask[dim], level));
-#else
-		level_t l = level + 1;
-		while (l--) {
-			coord_t shift = (coord_t)1 << l;
-			for (uint8_t dim = 0; dim < dimensions; dim++)
-				result |= (cart_coord[dim] & shift) << ((dimensions - 1) * l + dim);
-		}
-#endif
+		coord_t result = curve::Encode(level, cart_coord);
 		SetLevel(result, level);
 		return result;
 	}
 
 	// Alters a single unscaled Cartesian component. Example: L7 2D coord points to 100 x 50 and you want to set Y to 60: (coord, 7, 1, 60) (Y==1)
-	void setSingleUnscaled(coord_t &result, level_t level, uint8_t dim, uint32_t unscaled_coord) {
+	void setSingleUnscaled(coord_t &result, level_t level, uint8_t dim, unscaled_coord_t unscaled_coord) {
+		if (!curve::separable) {
+			unscaled_t unscaled = curve::Decode(level, RemoveLevel(result, level));
+			unscaled[dim] = unscaled_coord;
+			result = (result & ~RemoveLevel(~(coord_t)0, level)) | curve::Encode(level, unscaled);
+			return;
+		}
 		coord_t mask = RemoveLevel(bmi_mask[dim], level);
 		result &= ~mask; // clear bits for dim while leaving level bits untouched
-
-#ifdef __BMI2__
-		result |=  _pdep_u64(unscaled_coord, mask);
-#else
-		level++;
-		while (level--) {
-			coord_t shift = (coord_t)1 << level;
-			result |= (unscaled_coord & shift) << ((dimensions - 1) * level + dim);
-		}
-#endif
+		result |= (Morton<dimensions>::Dilate(unscaled_coord) << dim) & mask;
 	}
 
 	// Retrieve unscaled coord of single dimension from coord's level. Like getUnscaled(coord)[dim]
 	// Inspired by https://github.com/Forceflow/libmorton/
-	uint32_t getSingleUnscaled(coord_t c, uint8_t dim) {
-		level_t level = RemoveLevel(c) + dimensions;
-#ifdef __BMI2__
-		return  _pext_u64(c, bmi_mask[dim]);
-#else
-		uint32_t result = 0;
-		coord_t one = 1;
-		while (level -= dimensions) {
-			uint8_t shift_selector = level;
-			uint8_t shiftback = (dimensions - 1) * level / dimensions;
-			result |= (c & (one << (shift_selector + dim))) >> (shiftback + dim);
-		}
-		return result;
-#endif
+	unscaled_coord_t getSingleUnscaled(coord_t c, uint8_t dim) {
+		if (!curve::separable)
+			return getUnscaled(c)[dim];
+		RemoveLevel(c);
+		return Morton<dimensions>::Compact(c >> dim);
 	}
 
 	// Get entire unscaled position. Like getPositiobn()
 	// Inspired by https://github.com/Forceflow/libmorton/
 	unscaled_t getUnscaled(coord_t c) {
-		unscaled_t result {};
-		level_t level = RemoveLevel(c) + dimensions;
-#ifdef __BMI2__
-		for (uint8_t dim = 0; dim < dimensions; dim++)
-			result[dim] =  _pext_u64(c, bmi_mask[dim]);
-#else
-		while (level -= dimensions) {
-			uint8_t shift_selector = level - dimensions;
-			uint8_t shiftback = (dimensions - 1) * (level - dimensions) / dimensions;
-			for (uint8_t dim = 0; dim < dimensions; dim++)
-				result[dim] |= (c & (1U << (shift_selector + dim))) >> (shiftback + dim);
+		level_t bit_pos = RemoveLevel(c);
+		return curve::Decode(bit_pos / dimensions, c);
+	}
+
+	// Intervals [first, second] of level coords that cover exactly the unscaled box lo..hi (inclusive in every dimension).
+	// They are sorted and adjacent intervals are merged, so it is the smallest such list and a field can scan
+	// the box sequentially. Instead of BIGMIN / LITMAX jumps along the curve, this descends the 2^D-tree of the
+	// level: nodes inside the box are one interval, nodes outside are skipped, the rest is split further.
+	// The work grows with the surface of the box, not its volume.
+	static vector<pair<coord_t, coord_t> > rangesInBox(level_t level, unscaled_t lo, unscaled_t hi) {
+		vector<pair<coord_t, coord_t> > result;
+		const unscaled_coord_t last = ((unscaled_coord_t)1 << level) - 1;
+		for (uint8_t dim = 0; dim < dimensions; dim++) {
+			if (hi[dim] > last)
+				hi[dim] = last;
+			if (lo[dim] > hi[dim])
+				return result;
 		}
-#endif
+		unscaled_t node_lo;
+		node_lo.fill(0);
+		rangesInBox(level, 0, 0, node_lo, lo, hi, result);
 		return result;
 	}
 
+private:
+	// node are the curve bits of the first depth levels, node_lo its lowest unscaled corner on level
+	static void rangesInBox(level_t level, level_t depth, coord_t node, const unscaled_t& node_lo,
+			const unscaled_t& lo, const unscaled_t& hi, vector<pair<coord_t, coord_t> >& result) {
+		const unscaled_coord_t size = (unscaled_coord_t)1 << (level - depth);
+		bool inside = true;
+		for (uint8_t dim = 0; dim < dimensions; dim++) {
+			unscaled_coord_t node_hi = node_lo[dim] + (size - 1);
+			if (node_lo[dim] > hi[dim] || node_hi < lo[dim])
+				return;
+			inside &= node_lo[dim] >= lo[dim] && node_hi <= hi[dim];
+		}
+		if (inside) {
+			coord_t first = CreateMinLevel(level) | (node << (dimensions * (level - depth)));
+			coord_t last = first + (((coord_t)1 << (dimensions * (level - depth))) - 1);
+			if (!result.empty() && result.back().second + 1 == first)
+				result.back().second = last;
+			else
+				result.push_back(make_pair(first, last));
+			return;
+		}
+		unscaled_t child_lo;
+		for (coord_t child = 0; child < parts; child++) {
+			if (curve::separable) {
+				for (uint8_t dim = 0; dim < dimensions; dim++)
+					child_lo[dim] = node_lo[dim] + ((child >> dim) & 1) * (size >> 1);
+			} else {
+				child_lo = curve::Decode(depth + 1, (node << dimensions) | child);
+				for (uint8_t dim = 0; dim < dimensions; dim++)
+					child_lo[dim] <<= level - depth - 1;
+			}
+			rangesInBox(level, depth + 1, (node << dimensions) | child, child_lo, lo, hi, result);
+		}
+	}
+
+public:
+
 	// Increment / Decrement coord in-place. Returns true if a level-transition happened.
 	// !! IMPORTANT: The inc/dec routines only work correctly if a valid coord is passed. REASON: isValid() too expensive.
-	bool inc(coord_t &coord) {
+	static bool inc(coord_t &coord) {
 		level_t l = GetLevel(coord);
 		coord++;
 		if (coord > level_bounds[l].second) {
@@ -451,7 +1442,7 @@ public:
 	}
 
 	// Does not decrease below 1
-	bool dec(coord_t &coord) {
+	static bool dec(coord_t &coord) {
 		level_t l = GetLevel(coord);
 		coord--;
 		if (coord < level_bounds[l].first) {
@@ -467,7 +1458,7 @@ public:
 
 	// Increment / Decrement coord in-place by the amount of parts. Returns true if a level-transition happened.
 	// !! IMPORTANT: The inc/dec routines only work correctly if a valid coord is passed.
-	bool incParts(coord_t &coord) {
+	static bool incParts(coord_t &coord) {
 		level_t l = GetLevel(coord);
 		coord += parts;
 		if (coord > level_bounds[l].second) {
@@ -478,7 +1469,7 @@ public:
 	}
 
 	// Does not decrease below 1
-	bool decParts(coord_t &coord) {
+	static bool decParts(coord_t &coord) {
 		if (coord <= 1)
 			return true;
 		level_t l = GetLevel(coord);
@@ -495,7 +1486,7 @@ public:
 	array<coord_t, 1 << dimensions> getCoeffCoords(coord_t coord, uint32_t& bc_set) {
 		array<coord_t, 1 << dimensions> result;
 		bc_set = 0;
-		uint16_t high_part = extract(coord, 0); 	//
+		uint16_t high_part = getHighPart(coord);
 		coord_t origin = ReduceLevel(coord);
 
 		for (uint32_t i = 0; i < (1 << dimensions); i++) {
@@ -524,79 +1515,86 @@ public:
 	}
 
 	// Return an array of pairs of [coord, weight] to interpolate provided coord linearly.
-	// The resulting coords are all one lower level than coord. This version is quite fast (~20k 3D interpolations / ms)
-	// but struggles if more than one boundary is involved (boundary weights need to be redistributed), so it calls getCoeffs2
-	// that is an order of magnitude slower (2k 3D interp. / ms) but covers all boundary cases.
+	// The resulting coords are all one lower level than coord (or boundaries). Results equal getCoeffs2(), but
+	// coords may repeat and zero weights pad the array.
+	// On a separable curve moving along a dimension only changes the bits of that dimension, so every corner of the
+	// interpolation cube is origin XOR the single steps of its dimensions, a step out of the domain XORs in the boundary bits.
+	// Coords near more than one boundary take their merged weights from boundary_weights.
 	array<pair<coord_t, data_t>, 1 << dimensions> getCoeffs(coord_t coord) {
 		array<pair<coord_t, data_t>, 1 << dimensions> result;
-		if (coord == 1) { // coeffs of center coordinate is an average of all boundaries
-		    data_t weight = 1./parts;
+		if (coord == 1) { // coeffs of center coordinate is an average of all (2 * dimensions) boundaries
+		    data_t weight = 1. / (2 * dimensions);
 		    for (int i = 0; i < parts; i++)
-		        result[i] = make_pair(getNeighbor(1, i), weight);
+		        result[i] = i < 2 * dimensions ? make_pair(getNeighbor(1, i), weight) : make_pair(getNeighbor(1, 0), 0.);
 		    return result;
 		}
-		uint16_t high_part = extract(coord, 0);     //
+		uint16_t high_part = getHighPart(coord);
         coord_t origin = ReduceLevel(coord);
         uint32_t bc_set = 0;
-        uint32_t bcc_hit = 0;
-        for (uint32_t i = 0; i < (1 << dimensions); i++) {
-            coord_t current = origin;
-            uint32_t bcc = 0;
-            bool bc_hit = false;
-
+        array<coord_t, 1 << dimensions> corners;
+        corners[0] = origin;
+        if (curve::separable) {
             for (uint32_t j = 0; j < dimensions; j++) {
-                if (((i >> j) & 1) == 0)
-                    continue;
-
-                coord_t prev_current = current;
-                current = getNeighbor(current, 2 * j + (((high_part >> j) & 1) ^ 1));
-                if (IsBoundary(current)) {
-                    bcc++;
-                    result[i].first = current;
-                    current = prev_current;
+                coord_t step = origin ^ getNeighbor(origin, 2 * j + (((high_part >> j) & 1) ^ 1));
+                if (IsBoundary(step))
+                    bc_set |= 1U << j;
+                for (uint32_t i = 0; i < (1U << j); i++)
+                    corners[i | (1U << j)] = corners[i] ^ step;
+            }
+        } else {
+            // Interior corners are encoded from the moved position. Corners that leave the domain are only
+            // used as the boundary of their lowest leaving dimension j, hit from the corner of the dimensions below j.
+            level_t level = GetLevel(origin);
+            unscaled_t unscaled = getUnscaled(origin);
+            unscaled_t moved = unscaled;
+            for (uint32_t j = 0; j < dimensions; j++) {
+                moved[j] += (high_part >> j) & 1 ? 1 : -1;
+                if (!Wrap(moved[j], j, (unscaled_coord_t)1 << level))
                     bc_set |= 1U << j;
-                    bc_hit = true;
-                }
             }
-            if (!bc_hit)
-                result[i].first = current;
-            if (bcc > 1) {
-                result[i].first = 0;
-                bcc_hit++;
+            for (uint32_t i = 1; i < (1 << dimensions); i++) {
+                uint32_t hit = i & bc_set;
+                if (hit) {
+                    uint32_t j = __builtin_ctz(hit);
+                    corners[i] = corners[i & ~bc_set & ((1U << j) - 1)] | ((coord_t)1 << (HCS_COORD_BITS - 1)) |
+                            ((coord_t)(2 * j + (((high_part >> j) & 1) ^ 1)) << (HCS_COORD_BITS - 1 - dimensions));
+                    continue;
+                }
+                unscaled_t corner = unscaled;
+                for (uint32_t j = 0; j < dimensions; j++)
+                    if ((i >> j) & 1)
+                        corner[j] = moved[j];
+                corners[i] = CreateMinLevel(level) | curve::Encode(level, corner);
             }
         }
 
-        data_t total = 0;
-        for (uint32_t i = 0; i < (1 << dimensions); i++)
-            total += result[i].second = result[i].first == 0 ? 0 : weights_lookup[(bc_set << dimensions) + i];
-
-        //uint32_t boundary_count = __builtin_popcount(bc_set); // How many boundaries are in coeff set
-        if (bcc_hit > 0) {
-            data_t remainder = (1. - total) / (result.size() - bcc_hit);
-            for (auto& coeff : result)
-                if (coeff.first != 0)
-                    coeff.second += remainder;
-                else
-                    coeff.first = 1;
-
-            if (bc_set > 0) { // for impls that don't have popcount
-                auto coeffs = getCoeffs2(coord, bc_set);
-                int i = 0;
-                for (auto coeff : coeffs)
-                    result[i++] = coeff;
-
-                while (i < result.size()) {
-                    result[i++] = make_pair(result[0].first, 0.);
-                }
+        if (__builtin_popcount(bc_set) < 2) {
+            // A corner that hits the boundary stops there, dimensions above the boundary one are not walked
+            uint32_t stop_mask = bc_set ? (bc_set << 1) - 1 : ~0U;
+            for (uint32_t i = 0; i < (1 << dimensions); i++) {
+                result[i].first = corners[i & bc_set ? i & stop_mask : i];
+                result[i].second = weights_lookup[(bc_set << dimensions) + i];
             }
+            return result;
         }
 
+        const data_t* weights = &boundary_weights[bc_set << dimensions];
+        uint32_t n = 0;
+        for (uint32_t k = 0; k < (1 << dimensions); k++)
+            if (weights[k] != 0)
+                result[n++] = make_pair(corners[k], weights[k]);
+        // sorted by coord like getCoeffs2(), so sums over the coefficients do not depend on the path taken
+        for (uint32_t i = 1; i < n; i++)
+            for (uint32_t j = i; j > 0 && result[j].first < result[j - 1].first; j--)
+                swap(result[j], result[j - 1]);
+        for (uint32_t i = n; i < result.size(); i++)
+            result[i] = make_pair(result[0].first, 0.);
         return result;
 	}
 
-	// Slower version of getCoeffs, covers all scenarios, gets called by getCoeffs eventually
-	map<coord_t, data_t> getCoeffs2(coord_t coord, uint32_t boundary_set = 0) {
-		map<coord_t, data_t> result;
+	// Reference version of getCoeffs, walks every corner and merges duplicate coords
+	CoeffSet<1 << dimensions> getCoeffs2(coord_t coord, uint32_t boundary_set = 0) {
+		CoeffSet<1 << dimensions> result;
 		// Spawn a rectangle of lower-level coords around missing coord
 		// A (hyper)cubical interpolation (2D bi-linear, 3D tri-linear,...) is the best choice,
 		// simplexes (triangle, tetrahedron, ...) are not unique in orthogonal spaced coordinates.
@@ -639,14 +1637,14 @@ public:
 		//        1  1  1  =  0.25³         = 0.0156
 		//						TOTAL	    = 1 :)
 		// This principle is universal for all dimensions!
-        if (coord == 1) { // coeffs of center coordinate is an average of all boundaries
-            data_t weight = 1./parts;
-            for (int i = 0; i < parts; i++)
+        if (coord == 1) { // coeffs of center coordinate is an average of all (2 * dimensions) boundaries
+            data_t weight = 1. / (2 * dimensions);
+            for (int i = 0; i < 2 * dimensions; i++)
                 result[getNeighbor(1, i)] =  weight;
             return result;
         }
 
-        uint16_t high_part = extract(coord, 0); 	//
+        uint16_t high_part = getHighPart(coord);
         coord_t origin = ReduceLevel(coord);
         uint32_t boundary_quench = 0;
         if (boundary_quench == 0)
@@ -684,31 +1682,60 @@ public:
 
 	// Turns c into a linear-index that includes the level. Linear coords are great for storage but otherwise tedious to handle.
 	// HCS coords are linear within a level but have gaps between the levels.
-	size_t coord2index(coord_t c) {
+	// Level l starts at index (2^(l*D) - 1) / (2^D - 1), the bits of bmi_mask[0] below the level marker.
+	static size_t coord2index(coord_t c) {
 		level_t l = RemoveLevel(c);
-#ifdef __BMI2__
-		coord_t mask = _bzhi_u64(bmi_mask[0], l);
-#else
-		coord_t mask = bmi_mask[0] & ((1U << l) - 1);
+		return c + LowBits(bmi_mask[0], l);
+	}
+
+	// Turns a linear index back into a HCS coord, the inverse of coord2index().
+	// index * (2^D - 1) + 1 lies in [2^(l*D), 2^((l+1)*D)), so its highest bit gives the level l in O(1).
+	static coord_t index2coord(size_t index) {
+		level_t level = GetLevel((coord_t)index * part_mask + 1);
+		if (level > max_level)
+			throw range_error("index2coord oob ");
+		coord_t result = (coord_t)index - LowBits(bmi_mask[0], level * dimensions);
+		SetLevel(result, level);
+		return result;
+	}
+
+	// Batched coord2index() / index2coord() for n entries, with AVX-512 8 per step
+	static void coords2indices(const coord_t* in, size_t n, size_t* out) {
+		size_t i = 0;
+#if defined(HCS_SIMD) && defined(__AVX512F__) && defined(__AVX512CD__)
+		const __m512i v_one = _mm512_set1_epi64(1);
+		const __m512i v_offsets = _mm512_set1_epi64(bmi_mask[0]);
+		for (; i + 8 <= n; i += 8) {
+			__m512i coord = _mm512_loadu_si512((const void*)(in + i));
+			__m512i bit_pos = _mm512_sub_epi64(_mm512_set1_epi64(HCS_COORD_BITS - 1), _mm512_lzcnt_epi64(coord));
+			__m512i below = _mm512_sub_epi64(_mm512_sllv_epi64(v_one, bit_pos), v_one);
+			__m512i index = _mm512_add_epi64(_mm512_and_si512(coord, below), _mm512_and_si512(v_offsets, below));
+			_mm512_storeu_si512((void*)(out + i), index);
+		}
 #endif
-		return c + mask;
-	}
-
-	// Turns a linear index back into a HCS coord. SLOW!
-	// Should be avoided.
-	coord_t index2coord(size_t index) {
-		for (level_t l = 1; l < max_level; l++) {
-			size_t start_idx = coord2index(level_bounds[l].first);
-			size_t end_idx = coord2index(level_bounds[l].second);
-			if (index >= start_idx && index <= end_idx) {
-				index -= start_idx;
-				coord_t result = index;
-				SetLevel(result, l);
-				return result;
-			}
+		for (; i < n; i++)
+			out[i] = coord2index(in[i]);
+	}
+
+	// No range check in the AVX-512 lanes, indices must belong to levels up to max_level
+	static void indices2coords(const size_t* in, size_t n, coord_t* out) {
+		size_t i = 0;
+#if defined(HCS_SIMD) && defined(__AVX512F__) && defined(__AVX512CD__)
+		const __m512i v_one = _mm512_set1_epi64(1);
+		const __m512i v_offsets = _mm512_set1_epi64(bmi_mask[0]);
+		for (; i + 8 <= n; i += 8) {
+			__m512i index = _mm512_loadu_si512((const void*)(in + i));
+			__m512i scaled = _mm512_add_epi64(_mm512_sub_epi64(_mm512_slli_epi64(index, dimensions), index), v_one);
+			__m512i bit_pos = _mm512_sub_epi64(_mm512_set1_epi64(HCS_COORD_BITS - 1), _mm512_lzcnt_epi64(scaled));
+			// level = bit_pos / dimensions, exact with a fixed-point reciprocal for bit positions below 64
+			__m512i level = _mm512_srli_epi64(_mm512_mullo_epi32(bit_pos, _mm512_set1_epi64((65535 + dimensions) / dimensions)), 16);
+			__m512i level_bit = _mm512_sllv_epi64(v_one, _mm512_mullo_epi32(level, _mm512_set1_epi64(dimensions)));
+			__m512i offset = _mm512_and_si512(v_offsets, _mm512_sub_epi64(level_bit, v_one));
+			_mm512_storeu_si512((void*)(out + i), _mm512_or_si512(_mm512_sub_epi64(index, offset), level_bit));
 		}
-		cout << "R: " << index << endl;
-		throw range_error("index2coord oob ");
+#endif
+		for (; i < n; i++)
+			out[i] = index2coord(in[i]);
 	}
 
 
@@ -722,14 +1749,14 @@ public:
 
 		if (IsBoundary(coord)) {
 			coord_t origin = removeBoundary(coord);
-			result << "(BOUNDARY: " << (GetBoundaryDirection(coord)) << " ORIGIN : " << toString(origin) << ")";
+			result << "(BOUNDARY: " << (int)GetBoundaryDirection(coord) << " ORIGIN : " << toString(origin) << ")";
 			return result.str();
 		}
 
 		int level = GetLevel(coord);
 		result << "(" << level << ") [";
 		for (int i = 1; i <= level; i++)
-			result << extract(coord, level - i) << (i < level ? ", " : "]");
+			result << (int)extract(coord, level - i) << (i < level ? ", " : "]");
         pos_t pos = getPosition(coord);
         unscaled_t upos = getUnscaled(coord);
 		result << " (";
@@ -744,4 +1771,14 @@ public:
 
 };
 
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr coord_t HCS<dimensions, Curve, periodic>::part_mask;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr level_t HCS<dimensions, Curve, periodic>::parts;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr coord_t HCS<dimensions, Curve, periodic>::boundary_mask;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr level_t HCS<dimensions, Curve, periodic>::max_level;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr array<coord_t, dimensions * 2> HCS<dimensions, Curve, periodic>::successor_mask;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr array<coord_t, dimensions> HCS<dimensions, Curve, periodic>::bmi_mask;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr array<pair<coord_t, coord_t>, HCS_COORD_BITS> HCS<dimensions, Curve, periodic>::level_bounds;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr array<data_t, 1U << (dimensions * 2)> HCS<dimensions, Curve, periodic>::weights_lookup;
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic> constexpr array<data_t, 1U << (dimensions * 2)> HCS<dimensions, Curve, periodic>::boundary_weights;
+
 };
@@ -126,3 +126,164 @@ void div(Field<Tensor1<data_t, dimension>, HCS<dimension> >  &source, Field<data
 }
 
 
+
+// Reductions over scalar fields: sum(), dot(), norm2(), min(), max() and minmax(), of all stored values or only of
+// the top-level ones. The values are cut into blocks of reduce_block in the order of levels(), each block is
+// reduced in reduce_lanes interleaved lanes the compiler can keep in SIMD registers, then lanes and blocks are
+// combined pairwise. The blocks are shared out to GetThreads() threads, but the order of all additions only
+// depends on the structure of the fields, so the results are the same bit for bit for any number of threads.
+static const size_t reduce_block = 2048;
+static const int reduce_lanes = 8;
+
+// n consecutive values a[i] of a field and the values b[i] of the other field of dot() at the same coords.
+// If top is set only values with top[i] count.
+template <typename DTYPE>
+struct ReduceRun {
+	const DTYPE* a;
+	const DTYPE* b;
+	const char* top;
+	size_t n;
+};
+
+// Adds the run of the values i .. i+n-1 of span, for top_only nothing if the span holds no top-level coord
+template <typename DTYPE>
+bool AddReduceRun(vector<ReduceRun<DTYPE> >& runs, const FieldSpan<DTYPE>& span, size_t i, size_t n, const DTYPE* b, bool top_only) {
+	if (top_only && span.top == NULL && !span.all_top)
+		return false;
+	ReduceRun<DTYPE> run = {span.values + i, b, top_only && span.top != NULL ? span.top + i : NULL, n};
+	runs.push_back(run);
+	return true;
+}
+
+// Combines values[0 .. n-1] as a balanced binary tree, in place
+template <typename T, typename COMBINE>
+T PairwiseCombine(T* values, size_t n, COMBINE combine) {
+	for (; n > 1; n = (n + 1) / 2) {
+		for (size_t i = 0; i < n / 2; i++)
+			values[i] = combine(values[2 * i], values[2 * i + 1]);
+		if (n % 2)
+			values[n / 2] = values[n - 1];
+	}
+	return values[0];
+}
+
+// Reduces load(a[i], b[i]) of the runs with combine, values that do not count give init
+template <typename DTYPE, typename T, typename LOAD, typename COMBINE>
+T ReduceRuns(const vector<ReduceRun<DTYPE> >& runs, T init, LOAD load, COMBINE combine) {
+	vector<size_t> offsets;		// of the first value of each run
+	size_t n = 0;
+	for (auto& run : runs) {
+		offsets.push_back(n);
+		n += run.n;
+	}
+	size_t n_blocks = (n + reduce_block - 1) / reduce_block;
+	if (n_blocks == 0)
+		return init;
+	vector<T> partial(n_blocks);
+	ParallelFor(n_blocks, parallel_min_chunk / reduce_block, [&](size_t first, size_t last) {
+		for (size_t block = first; block < last; block++) {
+			T lane[reduce_lanes];
+			fill(lane, lane + reduce_lanes, init);
+			size_t pos = block * reduce_block, end = min(n, pos + reduce_block);
+			for (size_t r = upper_bound(offsets.begin(), offsets.end(), pos) - offsets.begin() - 1; pos < end; r++) {
+				size_t i = pos - offsets[r], len = min(runs[r].n, end - offsets[r]) - i;
+				pos += len;
+				const DTYPE* va = runs[r].a + i;
+				const DTYPE* vb = runs[r].b + i;
+				const char* top = runs[r].top != NULL ? runs[r].top + i : NULL;
+				size_t k = 0;
+				if (top == NULL) {
+					for (; k + reduce_lanes <= len; k += reduce_lanes)
+						for (int l = 0; l < reduce_lanes; l++)
+							lane[l] = combine(lane[l], load(va[k + l], vb[k + l]));
+					for (; k < len; k++)
+						lane[k % reduce_lanes] = combine(lane[k % reduce_lanes], load(va[k], vb[k]));
+				} else {
+					for (; k + reduce_lanes <= len; k += reduce_lanes)
+						for (int l = 0; l < reduce_lanes; l++)
+							lane[l] = combine(lane[l], top[k + l] ? load(va[k + l], vb[k + l]) : init);
+					for (; k < len; k++)
+						lane[k % reduce_lanes] = combine(lane[k % reduce_lanes], top[k] ? load(va[k], vb[k]) : init);
+				}
+			}
+			partial[block] = PairwiseCombine(lane, reduce_lanes, combine);
+		}
+	});
+	return PairwiseCombine(&partial[0], n_blocks, combine);
+}
+
+template <typename FIELD, typename T, typename LOAD, typename COMBINE>
+T ReduceField(FIELD& f, bool top_only, T init, LOAD load, COMBINE combine) {
+	vector<ReduceRun<data_t> > runs;
+	for (auto& span : f.levels())
+		AddReduceRun(runs, span, 0, span.size(), span.values, top_only);
+	return ReduceRuns(runs, init, load, combine);
+}
+
+template <typename FIELD>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value, data_t>::type sum(FIELD& f, bool top_only = false) {
+	return ReduceField(f, top_only, data_t(0), [](data_t a, data_t) { return a; }, [](data_t x, data_t y) { return x + y; });
+}
+
+// Sum of a * b over the coords of a. b may be stored differently, the runs of a are split where the spans of b
+// start or end, coords b lacks are read with getMany() and interpolate like get().
+template <typename FIELD, typename FIELD2>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value && is_base_of<FieldOperand, FIELD2>::value, data_t>::type dot(FIELD& a, FIELD2& b, bool top_only = false) {
+	auto spans_b = b.levels();
+	vector<ReduceRun<data_t> > runs;
+	vector<coord_t> missing;		// coords of a that b lacks
+	vector<pair<size_t, size_t> > missing_runs;		// runs reading them, index of the run and of its first value
+	size_t j = 0;		// both walked in ascending coord order
+	for (auto& span : a.levels())
+		for (coord_t c = span.start; c <= span.end; ) {
+			while (j < spans_b.size() && spans_b[j].end < c)
+				j++;
+			coord_t last = span.end;
+			if (j < spans_b.size() && spans_b[j].start <= c) {
+				last = min(last, spans_b[j].end);
+				AddReduceRun(runs, span, c - span.start, last - c + 1, spans_b[j].values + (c - spans_b[j].start), top_only);
+			} else {
+				if (j < spans_b.size())
+					last = min(last, spans_b[j].start - 1);
+				if (AddReduceRun(runs, span, c - span.start, last - c + 1, (const data_t*)NULL, top_only)) {
+					missing_runs.push_back(make_pair(runs.size() - 1, missing.size()));
+					for (coord_t m = c; m <= last; m++)
+						missing.push_back(m);
+				}
+			}
+			c = last + 1;
+		}
+	vector<data_t> missing_values(missing.size());
+	if (!missing.empty())
+		b.getMany(&missing[0], missing.size(), &missing_values[0]);
+	for (auto& m : missing_runs)
+		runs[m.first].b = &missing_values[m.second];
+	return ReduceRuns(runs, data_t(0), [](data_t x, data_t y) { return x * y; }, [](data_t x, data_t y) { return x + y; });
+}
+
+// Euclidean norm, sqrt(dot(f, f))
+template <typename FIELD>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value, data_t>::type norm2(FIELD& f, bool top_only = false) {
+	return sqrt(ReduceField(f, top_only, data_t(0), [](data_t a, data_t) { return a * a; }, [](data_t x, data_t y) { return x + y; }));
+}
+
+// +infinity for no values
+template <typename FIELD>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value, data_t>::type min(FIELD& f, bool top_only = false) {
+	return ReduceField(f, top_only, numeric_limits<data_t>::infinity(), [](data_t a, data_t) { return a; }, [](data_t x, data_t y) { return y < x ? y : x; });
+}
+
+// -infinity for no values
+template <typename FIELD>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value, data_t>::type max(FIELD& f, bool top_only = false) {
+	return ReduceField(f, top_only, -numeric_limits<data_t>::infinity(), [](data_t a, data_t) { return a; }, [](data_t x, data_t y) { return y > x ? y : x; });
+}
+
+// min() and max() in one pass
+template <typename FIELD>
+typename enable_if<is_base_of<FieldOperand, FIELD>::value, pair<data_t, data_t> >::type minmax(FIELD& f, bool top_only = false) {
+	typedef pair<data_t, data_t> range_t;
+	return ReduceField(f, top_only, range_t(numeric_limits<data_t>::infinity(), -numeric_limits<data_t>::infinity()),
+			[](data_t a, data_t) { return range_t(a, a); },
+			[](const range_t& x, const range_t& y) { return range_t(y.first < x.first ? y.first : x.first, y.second > x.second ? y.second : x.second); });
+}
@@ -0,0 +1,131 @@
+/*
+ * parallel.hpp
+ *
+ *	Threads for field-wide operations (fill, arithmetic, expressions, convert / merge).
+ *	They run on a single thread unless the number of threads is raised once at startup:
+ *
+ *	  SetThreads(0);		// all hardware threads
+ *	  SetThreads(16);
+ *
+ *	A range is split into one consecutive piece per thread, DenseField splits its index range, SparseField its
+ *	buckets. Functions passed to convert() and merge() only run on several threads at once if the call asks for
+ *	it, convert(source, fn, true).
+ *
+ *	The threads are started once and wait for work between operations.
+ */
+#pragma once
+
+namespace hcs {
+
+// Below this many values per thread a thread costs more than it saves
+static const size_t parallel_min_chunk = 1 << 14;
+
+// The number of threads for field-wide operations, 1 by default
+inline unsigned& ThreadsSetting() {
+	static unsigned threads = 1;
+	return threads;
+}
+
+// 0 = all hardware threads
+inline void SetThreads(unsigned threads) {
+	ThreadsSetting() = threads == 0 ? max(1U, thread::hardware_concurrency()) : threads;
+}
+
+inline unsigned GetThreads() {
+	return ThreadsSetting();
+}
+
+// Worker threads kept between operations, started when first needed. One operation at a time uses them, a
+// RunThreads() from inside a running one (or from another thread meanwhile) runs its pieces one after another.
+class ThreadPool {
+public:
+	static ThreadPool& instance() {
+		static ThreadPool pool;
+		return pool;
+	}
+
+	~ThreadPool() {
+		{
+			lock_guard<mutex> lock(m);
+			stop = true;
+		}
+		wake.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	// fn(t) for t = 0 .. threads - 1, t = 0 in the calling thread
+	void run(unsigned threads, const function<void(unsigned)>& fn) {
+		unique_lock<mutex> running(run_lock, try_to_lock);
+		if (!running.owns_lock() || threads <= 1) {
+			for (unsigned t = 0; t < threads; t++)
+				fn(t);
+			return;
+		}
+		{
+			lock_guard<mutex> lock(m);
+			while (workers.size() < threads - 1)
+				workers.push_back(thread(&ThreadPool::work, this, unsigned(workers.size() + 1), generation));
+			job = &fn;
+			n_threads = threads;
+			pending = threads - 1;
+			generation++;
+		}
+		wake.notify_all();
+		fn(0);
+		unique_lock<mutex> lock(m);
+		done.wait(lock, [this] { return pending == 0; });
+		job = NULL;
+	}
+
+private:
+	ThreadPool() : job(NULL), n_threads(0), pending(0), generation(0), stop(false) {}
+
+	void work(unsigned t, size_t seen) {
+		unique_lock<mutex> lock(m);
+		for (;;) {
+			wake.wait(lock, [&] { return stop || generation != seen; });
+			if (stop)
+				return;
+			seen = generation;
+			if (t >= n_threads)
+				continue;
+			const function<void(unsigned)>* fn = job;
+			lock.unlock();
+			(*fn)(t);
+			lock.lock();
+			if (--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	mutex m, run_lock;
+	condition_variable wake, done;
+	vector<thread> workers;
+	const function<void(unsigned)>* job;
+	unsigned n_threads, pending;
+	size_t generation;
+	bool stop;
+};
+
+// Run fn(t) for t = 0 .. threads - 1 on the threads of the pool, t = 0 in the calling thread
+template<typename FN>
+void RunThreads(unsigned threads, FN fn) {
+	ThreadPool::instance().run(threads, function<void(unsigned)>(fn));
+}
+
+// Run fn(begin, end) on consecutive pieces of 0 .. n-1, one per thread, but none smaller than min_chunk
+template<typename FN>
+void ParallelFor(size_t n, size_t min_chunk, FN fn) {
+	size_t threads = min<size_t>(GetThreads(), n / max<size_t>(min_chunk, 1));
+	if (threads <= 1) {
+		if (n > 0)
+			fn(0, n);
+		return;
+	}
+	RunThreads(threads, [&](unsigned t) {
+		fn(n * t / threads, n * (t + 1) / threads);
+	});
+}
+
+}
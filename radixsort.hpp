@@ -0,0 +1,116 @@
+/*
+ * radixsort.hpp
+ *
+ *	LSD radix sort of coord_t keys into the order SparseField keeps its buckets in (map with greater<coord_t>):
+ *	descending, so the highest level comes first and each level runs backwards along the curve.
+ *	A payload array can be carried along, ties keep their input order (stable).
+ *
+ *	Example:
+ *	  vector<coord_t> keys = ...;
+ *	  vector<uint32_t> particle_ids = ...;
+ *	  RadixSort(&keys[0], &particle_ids[0], keys.size());
+ *
+ *	Each pass sorts one byte of the key, passes whose byte is the same for all keys are skipped. For coords of
+ *	few levels that are the high bytes, they mostly hold the level marker. Large inputs are split into chunks,
+ *	one per thread: every thread counts its chunk and scatters it to the offsets of its chunk.
+ */
+#pragma once
+
+namespace hcs {
+
+// Below this many keys per thread a thread costs more than it saves
+static const size_t radix_min_chunk = 1 << 16;
+
+// Sort keys descending, payload[i] moves with keys[i] (payload may be NULL).
+// threads = 0 uses all hardware threads, small inputs always run on a single one.
+template<typename PAYLOAD>
+void RadixSort(coord_t* keys, PAYLOAD* payload, size_t n, unsigned threads = 0) {
+	const unsigned digits = sizeof(coord_t);
+	if (threads == 0)
+		threads = thread::hardware_concurrency();
+	threads = max<size_t>(1, min<size_t>(threads, n / radix_min_chunk));
+	auto chunk = [n, threads](unsigned t) { return n * t / threads; };
+
+	// Histograms of all digits do not change while sorting, they tell which passes can be skipped
+	vector<vector<size_t> > counts(threads, vector<size_t>(256 * digits, 0));
+	RunThreads(threads, [&](unsigned t) {
+		size_t* count = &counts[t][0];
+		for (size_t i = chunk(t); i < chunk(t + 1); i++)
+			for (unsigned d = 0; d < digits; d++)
+				count[d * 256 + uint8_t(keys[i] >> (8 * d))]++;
+	});
+
+	vector<coord_t> key_buffer;
+	vector<PAYLOAD> payload_buffer;
+	coord_t* key_src = keys;
+	coord_t* key_dst = NULL;
+	PAYLOAD* payload_src = payload;
+	PAYLOAD* payload_dst = NULL;
+	vector<array<size_t, 256> > offsets(threads);
+	bool permuted = false;
+	for (unsigned d = 0; d < digits; d++) {
+		const unsigned shift = 8 * d;
+		size_t same = 0;
+		if (n > 0)
+			for (unsigned t = 0; t < threads; t++)
+				same += counts[t][d * 256 + uint8_t(key_src[0] >> shift)];
+		if (same == n)
+			continue;
+
+		if (key_dst == NULL) {
+			key_buffer.resize(n);
+			key_dst = &key_buffer[0];
+			if (payload) {
+				payload_buffer.resize(n);
+				payload_dst = &payload_buffer[0];
+			}
+		}
+
+		// Chunks of a permuted array have other counts, only the first pass can use the initial ones
+		RunThreads(threads, [&](unsigned t) {
+			array<size_t, 256>& count = offsets[t];
+			if (!permuted) {
+				copy(counts[t].begin() + d * 256, counts[t].begin() + (d + 1) * 256, count.begin());
+				return;
+			}
+			count.fill(0);
+			for (size_t i = chunk(t); i < chunk(t + 1); i++)
+				count[uint8_t(key_src[i] >> shift)]++;
+		});
+
+		// Highest digit first, within a digit the chunks in order to stay stable
+		size_t position = 0;
+		for (int digit = 255; digit >= 0; digit--)
+			for (unsigned t = 0; t < threads; t++) {
+				size_t count = offsets[t][digit];
+				offsets[t][digit] = position;
+				position += count;
+			}
+
+		RunThreads(threads, [&](unsigned t) {
+			array<size_t, 256>& offset = offsets[t];
+			for (size_t i = chunk(t); i < chunk(t + 1); i++) {
+				size_t j = offset[uint8_t(key_src[i] >> shift)]++;
+				key_dst[j] = key_src[i];
+				if (payload)
+					payload_dst[j] = move(payload_src[i]);
+			}
+		});
+		swap(key_src, key_dst);
+		swap(payload_src, payload_dst);
+		permuted = true;
+	}
+
+	if (key_src != keys) {	// odd number of passes
+		copy(key_src, key_src + n, keys);
+		if (payload)
+			move(payload_src, payload_src + n, payload);
+	}
+}
+
+// ... keys only
+inline void RadixSort(coord_t* keys, size_t n, unsigned threads = 0) {
+	RadixSort(keys, (uint8_t*)NULL, n, threads);
+}
+
+}
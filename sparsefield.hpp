@@ -15,7 +15,7 @@
  * - A bracket operator for coordinates is implemented, with adjustable behavior for non-existing coords.
  * - The performance of exists() relies on STL's map::lower_bound O(log) complexity
  * - The center coordinate (0) always exists
- * - boundary conditions can be implemented as lambdas
+ * - Dirichlet, Neumann and reflecting boundary conditions built in, others can be implemented as lambdas
  *
  */
 
@@ -42,6 +42,18 @@ private:
     	createEntireLevel(level);
     }
 
+    // Takes the structure of the first SparseField operand of a field expression, not its values, and evaluates the
+    // expression into it, see field.hpp. Expressions without an operand that can be a SparseField don't compile.
+    template <typename E, typename = typename enable_if<is_base_of<FieldExprNode, E>::value>::type>
+    SparseField(const E& expr) : SparseField(Field<DTYPE, HCSTYPE>::template structureOf<SparseField>(expr).hcs) {
+        static_assert(FieldExprHasStructure<SparseField, E>::value, "The expression has no SparseField operand to take the structure from");
+        const SparseField& f = Field<DTYPE, HCSTYPE>::template structureOf<SparseField>(expr);
+        takeStructure(const_cast<SparseField&>(f));
+        this->bracket_behavior = f.bracket_behavior;
+        this->copyBoundary(f);
+        *this = expr;
+    }
+
 
 
     // The copy constructor, to make quick copies of the field and its structure
@@ -51,9 +63,7 @@ private:
         this->hcs = f.hcs;
         this->bracket_behavior = f.bracket_behavior;
         this->data = f.data;
-        this->boundary_propagate = f.boundary_propagate;
-        for (int i = 0; i < 64; i++)
-            this->boundary[i] = this->boundary_propagate[i] ? f.boundary[i] : nullptr;
+        this->copyBoundary(f);
         // The buckets are pointers, so in order to not get a reference to the values, we need to copy separately.
         for (auto & bucket : data) {
             bucket.second = new Bucket(*(bucket.second)); // Calls implicit copy constructor of Bucket.
@@ -61,6 +71,7 @@ private:
         _current = NULL;
         for (int i = 0; i < 64; i++)
             _level_current[i] = NULL;
+        dirty = f.dirty;
     }
 
     // Because we "new"d Buckets, we need to release them.
@@ -94,6 +105,9 @@ private:
     Bucket* _current;
     Bucket* _level_current[64];
 
+    // Coords marked with markDirty(), in the order of data
+    set<coord_t, greater<coord_t> > dirty;
+
  public:
     class SparseIterator : public Field<DTYPE, HCSTYPE>::CustomIterator {
     public:
@@ -186,6 +200,56 @@ private:
         return NULL;//typename Field<DTYPE, HCSTYPE>::Iterator(new SparseIterator(NULL));//new SparseIterator(this, top_only, only_level));
     }
 
+    // Calls fn(coord, value&) for the same coords as begin(top_only, only_level) in the same order, without
+    // the virtual iterator: bucket by bucket, the map is sorted by descending level.
+    template <typename FN>
+    void for_each(bool top_only, int only_level, FN fn) {
+        for (auto& kv : data) {
+            Bucket* b = kv.second;
+            if (only_level >= 0) {
+                int level = hcs.GetLevel(b->start);
+                if (level > only_level)
+                    continue;
+                if (level < only_level)
+                    break;
+            }
+            DTYPE* value = &b->data[0];
+            const char* top = &b->top[0];
+            size_t n = b->data.size();
+            for (size_t i = 0; i < n; i++)
+                if (!top_only || top[i])
+                    fn(b->start + i, value[i]);
+        }
+    }
+
+    template <typename FN>
+    void for_each(FN fn) {
+        for_each(false, -1, fn);
+    }
+
+    // Field::levels(), one span per bucket. Descending is the order of the map.
+    vector<FieldSpan<DTYPE> > levels(int lo = 0, int hi = -1, bool descending = false) {
+        vector<FieldSpan<DTYPE> > result;
+        result.reserve(data.size());
+        hi = hi < 0 ? getHighestLevel() : min<int>(hi, getHighestLevel());
+        for (auto it = data.lower_bound(hcs.CreateMaxLevel(hi)); it != data.end(); ++it) {
+            Bucket* b = it->second;
+            FieldSpan<DTYPE> span;
+            span.level = hcs.GetLevel(b->start);
+            if (span.level < lo)
+                break;
+            span.start = b->start;
+            span.end = b->end;
+            span.values = &b->data[0];
+            span.top = &b->top[0];
+            span.all_top = false;
+            result.push_back(span);
+        }
+        if (!descending)
+            reverse(result.begin(), result.end());
+        return result;
+    }
+
     // Returns the number of available elements for this field
     size_t nElements() {
         size_t sum = 0;
@@ -203,22 +267,12 @@ private:
     }
 
     // Do we have a value for this coord? And if yes, make sure it is in _current
-    // A bucket's end coord is its last existing coord
-    bool exists(coord_t coord) {
-        if (this->_current != NULL && coord >= _current->start && coord <= _current->end) {
-            return true;
-        }
-        if (hcs.IsBoundary(coord))
-            return false;
-        map_iter_t result = data.lower_bound(coord);
-        if (result == data.end() || result->second->end < coord)
-            return false;
-        this->_current = result->second;
-        return true;
+    bool exists(coord_t coord) final {
+        return exists(coord, _current);
     }
 
     // Does not query coefficients, throws if coord does not exist
-    DTYPE& getDirect(coord_t coord) {
+    DTYPE& getDirect(coord_t coord) final {
         if (!this->exists(coord))
             throw range_error("[]: Coord does not exist");
         return this->_current->get(coord);
@@ -227,14 +281,24 @@ private:
     // Returns value for coord, if not present, interpolates.
     // if it is not TLC, return value anyway. To retrieve proper values from non-TLC
     // call propagate() first
-    DTYPE get(coord_t coord, bool use_non_top = true) {
+    DTYPE get(coord_t coord, bool use_non_top = true) final {
         DTYPE result = 0;
-        Field<DTYPE, HCSTYPE>::get(coord, result, use_non_top);
+        this->getT(this, coord, result, use_non_top);
         return result;
     }
 
+    // Field::getMany() with the lookups of this class inlined
+    void getMany(const coord_t* coords, size_t n, DTYPE* results, bool use_non_top = true) {
+        this->getManyT(this, coords, n, results, use_non_top);
+    }
+
+    // Field::getCoeffs() with exists() and isTop() of this class inlined
+    void getCoeffs(const coord_t coord, typename Field<DTYPE, HCSTYPE>::coeff_map_t &coeffs, bool use_non_top = true, int recursion = 0) {
+        this->getCoeffsT(this, coord, coeffs, use_non_top, recursion);
+    }
+
     // Do coordinates exist in a higher level?
-    bool isTop(coord_t coord) {
+    bool isTop(coord_t coord) final {
         if (!exists(coord))
             throw range_error("isTop coord does not exist!");
         return this->_current->isTop(coord);
@@ -268,6 +332,37 @@ private:
                 lower_level_cache.push_back(make_tuple(hcs.ReduceLevel(c), total));
             }
         }
+        dirty.clear();
+    }
+
+    // Throws if coord does not exist
+    void markDirty(coord_t coord) {
+        if (!exists(coord))
+            throw range_error("markDirty: Coord does not exist");
+        dirty.insert(coord);
+    }
+
+    // Takes the marks in map order, highest level first, so all children of a level are done before their parents,
+    // which are marked in turn. Averages like propagate(), which does not write level 1 either.
+    void propagateDirty() {
+        while (!dirty.empty()) {
+            coord_t c = *dirty.begin();
+            if (hcs.GetLevel(c) <= 2)
+                break;
+            c -= c % hcs.parts;                                 // first of the parts sharing the parent
+            dirty.erase(dirty.begin(), dirty.upper_bound(c));  // the siblings are done with it
+            if (!exists(c))                                     // coarsened away since it was marked
+                continue;
+            Bucket* b = _current;
+            DTYPE total = 0;
+            for (int j = 0; j < hcs.parts; j++)
+                total += b->get(c + j);
+            total /= hcs.parts;
+            coord_t parent = hcs.ReduceLevel(c);
+            getDirect(parent) = total;
+            dirty.insert(parent);
+        }
+        dirty.clear();
     }
 
 
@@ -324,6 +419,15 @@ private:
         }
     }
 
+    // refineTo() for many coords, coords gets sorted. In bucket order consecutive coords mostly share
+    // their bucket, so exists() hits _current, and duplicates are skipped.
+    void refineTo(coord_t* coords, size_t n) {
+        RadixSort(coords, n);
+        for (size_t i = 0; i < n; i++)
+            if (i == 0 || coords[i] != coords[i - 1])
+                refineTo(coords[i]);
+    }
+
     // Remove all coords on higher level above coord
     void coarse(coord_t coord) {
         if (!exists(coord))
@@ -420,9 +524,8 @@ private:
             ++iter_f;
         }
         _current = NULL;
-        this->boundary_propagate = f.boundary_propagate;
-        for (int i = 0; i < 64; i++)
-            this->boundary[i] = this->boundary_propagate[i] ? f.boundary[i] : nullptr;
+        dirty = f.dirty;
+        this->copyBoundary(f);
         return *this;
     };
 
@@ -434,11 +537,220 @@ private:
     };
 
     SparseField &operator=(const DTYPE& f){
-        Field<DTYPE,HCSTYPE>::operator =(f);
+        parallelBuckets(true, [&](Bucket** first, Bucket** last) {
+            for (Bucket** b = first; b != last; b++)
+                fill((*b)->data.begin(), (*b)->data.end(), f);
+        });
+        return *this;
+    }
+
+    // Lazy arithmetic, see the end of field.hpp: a = b + 2. * c; evaluates in one pass, without temporary fields
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, SparseField&>::type operator=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v = x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator+=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v += x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator-=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v -= x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator*=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v *= x; });
+        return *this;
+    }
+
+    template <typename E>
+    typename enable_if<is_base_of<FieldExprNode, E>::value, Field<DTYPE, HCSTYPE>&>::type operator/=(const E& expr) {
+        evaluate(expr, [](DTYPE& v, const DTYPE& x) { v /= x; });
+        return *this;
+    }
+
+    // Values of a bucket are stored consecutively, a missing coord is missing up to the start of the next bucket
+    DTYPE* contiguousAt(coord_t coord, coord_t& run_end) final {
+        return contiguousAt(coord, run_end, _current);
+    }
+
+    // Read-only access that keeps its own bucket cache instead of _current. Any number of threads can read the
+    // field at once, each through its own Accessor, as long as the field does not change meanwhile:
+    //  SparseScalarField2::Accessor a(field);
+    //  a.get(coord);
+    // Built-in boundary conditions read through the Accessor too, boundary functions get the field itself.
+    class Accessor {
+    public:
+        typedef DTYPE value_t;
+
+        Accessor(SparseField& field) : field(&field), current(NULL) {}
+
+        bool exists(coord_t coord) {
+            return field->exists(coord, current);
+        }
+
+        bool isTop(coord_t coord) {
+            if (!exists(coord))
+                throw range_error("isTop coord does not exist!");
+            return current->isTop(coord);
+        }
+
+        DTYPE& getDirect(coord_t coord) {
+            if (!exists(coord))
+                throw range_error("[]: Coord does not exist");
+            return current->get(coord);
+        }
+
+        DTYPE get(coord_t coord, bool use_non_top = true) {
+            DTYPE result = 0;
+            field->getT(this, coord, result, use_non_top);
+            return result;
+        }
+
+        void getMany(const coord_t* coords, size_t n, DTYPE* results, bool use_non_top = true) {
+            field->getManyT(this, coords, n, results, use_non_top);
+        }
+
+        DTYPE* contiguousAt(coord_t coord, coord_t& run_end) {
+            return field->contiguousAt(coord, run_end, current);
+        }
+
+        bool concurrent() {
+            return true;
+        }
+
+    private:
+        SparseField* field;
+        Bucket* current;
+    };
+
+private:
+    // exists() with the bucket cache of the caller, the map is only read. A bucket's end coord is its last
+    // existing coord.
+    bool exists(coord_t coord, Bucket*& cache) {
+        if (cache != NULL && coord >= cache->start && coord <= cache->end)
+            return true;
+        if (hcs.IsBoundary(coord))
+            return false;
+        map_iter_t result = data.lower_bound(coord);
+        if (result == data.end() || result->second->end < coord)
+            return false;
+        cache = result->second;
+        return true;
+    }
+
+    DTYPE* contiguousAt(coord_t coord, coord_t& run_end, Bucket*& cache) {
+        if (exists(coord, cache)) {
+            run_end = min(run_end, cache->end);
+            return &cache->get(coord);
+        }
+        map_iter_t next = data.lower_bound(coord);    // first bucket below coord, the map is sorted descending
+        if (next != data.begin())
+            run_end = min(run_end, (--next)->first - 1);
+        return NULL;
+    }
+
+    // Calls fn(first, last) for consecutive pieces [first, last) of all buckets. If parallel, one piece per
+    // thread with the buckets that start in its share of the values, so large and small buckets are shared out
+    // evenly. On a single thread fn gets one bucket at a time, straight from the map.
+    template <typename FN>
+    void parallelBuckets(bool parallel, FN fn) {
+        if (!parallel || GetThreads() <= 1) {
+            for (auto& kv : data)
+                fn(&kv.second, &kv.second + 1);
+            return;
+        }
+        vector<Bucket*> buckets;
+        vector<size_t> offsets;     // of the first value of each bucket
+        size_t n = 0;
+        for (auto& kv : data) {
+            buckets.push_back(kv.second);
+            offsets.push_back(n);
+            n += kv.second->data.size();
+        }
+        ParallelFor(n, parallel ? parallel_min_chunk : numeric_limits<size_t>::max(), [&](size_t first, size_t last) {
+            size_t i = lower_bound(offsets.begin(), offsets.end(), first) - offsets.begin();
+            size_t j = lower_bound(offsets.begin() + i, offsets.end(), last) - offsets.begin();
+            fn(&buckets[0] + i, &buckets[0] + j);
+        });
+    }
+
+    // Applies op(value, expr at coord) to all coords, bucket by bucket
+    template <typename E, typename OP>
+    void evaluate(const E& expr, OP op) {
+        parallelBuckets(expr.concurrent(), [&](Bucket** first, Bucket** last) {
+            E e = expr;
+            for (Bucket** b = first; b != last; b++)
+                Field<DTYPE, HCSTYPE>::evaluateRun(e, (*b)->start, (*b)->end, &(*b)->data[0], op);
+        });
+    }
+
+    // Compound ops with any field, another SparseField is read through its Accessor
+    template <typename OP>
+    Field<DTYPE, HCSTYPE>& evaluateField(const Field<DTYPE, HCSTYPE>& rhs, OP op) {
+        const SparseField* sparse = dynamic_cast<const SparseField*>(&rhs);
+        if (sparse)
+            evaluate(FieldTerm<SparseField>(*sparse), op);
+        else
+            evaluate(FieldTerm<Field<DTYPE, HCSTYPE> >(rhs), op);
         return *this;
     }
 
-    SparseField<DTYPE, HCSTYPE> operator-() const { SparseField<DTYPE, HCSTYPE> result = *this; for (auto e : result) e.second = -e.second; return result;}
+    // fn(coord, value&) for the top-level coords, in parallel if asked to
+    template <typename FN>
+    void forTop(bool parallel, FN fn) {
+        parallelBuckets(parallel, [&](Bucket** first, Bucket** last) {
+            for (Bucket** b = first; b != last; b++)
+                for (size_t i = 0; i < (*b)->data.size(); i++)
+                    if ((*b)->top[i])
+                        fn((*b)->start + i, (*b)->data[i]);
+        });
+    }
+
+public:
+
+
+    // Arithmetic ops of Field and values, see evaluate() and evaluateField()
+    Field<DTYPE, HCSTYPE>& operator*= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return evaluateField(rhs, [](DTYPE& v, const DTYPE& x) { v *= x; });
+    }
+
+    Field<DTYPE, HCSTYPE>& operator/= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return evaluateField(rhs, [](DTYPE& v, const DTYPE& x) { v /= x; });
+    }
+
+    Field<DTYPE, HCSTYPE>& operator+= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return evaluateField(rhs, [](DTYPE& v, const DTYPE& x) { v += x; });
+    }
+
+    Field<DTYPE, HCSTYPE>& operator-= (const Field<DTYPE, HCSTYPE>& rhs) {
+        return evaluateField(rhs, [](DTYPE& v, const DTYPE& x) { v -= x; });
+    }
+
+    Field<DTYPE, HCSTYPE>& operator*= (const DTYPE& val) { return *this *= FieldScalar<DTYPE>(val); }
+    Field<DTYPE, HCSTYPE>& operator/= (const DTYPE& val) { return *this /= FieldScalar<DTYPE>(val); }
+    Field<DTYPE, HCSTYPE>& operator+= (const DTYPE& val) { return *this += FieldScalar<DTYPE>(val); }
+    Field<DTYPE, HCSTYPE>& operator-= (const DTYPE& val) { return *this -= FieldScalar<DTYPE>(val); }
+
+    // convert() and merge() of Field with the callable inlined. With parallel the callable runs on SetThreads()
+    // threads at once if the sources allow concurrent reads, it must not touch shared state then.
+    template <typename DTYPE2, typename FN>
+    void convert(Field<DTYPE2, HCSTYPE> &source, FN convert_fn, bool parallel = false) {
+        forTop(parallel && source.concurrentReads(), [&](coord_t c, DTYPE& v) { v = convert_fn(c, source); });
+    }
+
+    template <typename DTYPE2, typename FN>
+    void merge(Field<DTYPE2, HCSTYPE> &source1, Field<DTYPE2, HCSTYPE> &source2, FN merge_fn, bool parallel = false) {
+        forTop(parallel && source1.concurrentReads() && source2.concurrentReads(), [&](coord_t c, DTYPE& v) {
+            v = merge_fn(c, source1.get(c), source2.get(c));
+        });
+    }
 
     // Clears the field and takes the same coordinate structure as the provided field, without copying their
     // values. The provided field may have a different DTYPE. The newly created coords are initialized with zero.
@@ -495,6 +807,7 @@ private:
         data[1] = new Bucket(1, 1);
         data[1]->setTop(1, true);
         _current = NULL;
+        dirty.clear();
     }
 
     void printBucketInfo() {
@@ -595,72 +908,3 @@ private:
 
 };
 
-// Other non-member arithmetic ops
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator* (const SparseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result *= rhs;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator* (const DTYPE& val, const SparseField<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = rhs;
-    result *= val;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator* (const SparseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result *= val;
-    return result;
-};
-
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator/ (const SparseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result /= rhs;
-    return result;
-};
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator/ (const DTYPE& val, const SparseField<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = rhs;
-    for (auto e : result)
-        e.second = val / e.second;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator/ (const SparseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result /= val;
-    return result;
-}
-
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator+ (const SparseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result += rhs;
-    return result;
-};
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator+ (const DTYPE& val, const SparseField<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = rhs;
-    result += val;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator+ (const SparseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result += val;
-    return result;
-}
-
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator- (const SparseField<DTYPE, HCSTYPE>& lhs, const Field<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result -= rhs;
-    return result;
-};
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator- (const DTYPE& val, const SparseField<DTYPE, HCSTYPE>& rhs) {
-    SparseField<DTYPE, HCSTYPE> result = -rhs;
-    result += val;
-    return result;
-}
-template <typename DTYPE, typename HCSTYPE> SparseField<DTYPE, HCSTYPE> operator- (const SparseField<DTYPE, HCSTYPE>& lhs, const DTYPE& val) {
-    SparseField<DTYPE, HCSTYPE> result = lhs;
-    result -= val;
-    return result;
-}
-
-
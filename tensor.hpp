@@ -153,6 +153,10 @@ template <typename T, unsigned char D> Tensor1<T, D> operator- (const Tensor1<T,
 template <typename T, unsigned char D> bool operator< (const Tensor1<T, D>& lhs, const Tensor1<T, D>& rhs)
 { return lhs.norm() < rhs.norm(); }
 
+// Mirror image at a boundary normal to dimension dim, see Field::BC_REFLECT
+template <typename T, unsigned char D> Tensor1<T, D> reflect(const Tensor1<T, D>& t, uint8_t dim)
+{ Tensor1<T, D> result = t; result.value[dim] = -result.value[dim]; return result;}
+
 /*
 template <typename T, unsigned char D> valarray<bool> operator== (const Tensor1<T, D>& lhs, const Tensor1<T, D>& rhs);
 template <typename T, unsigned char D> valarray<bool> operator== (const T& val, const Tensor1<T, D>& rhs);
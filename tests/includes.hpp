@@ -34,10 +34,15 @@
 #include <chrono>
 #include <functional>
 #include <bitset>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 
 // Own includes
 #include "hcs.hpp"
+#include "parallel.hpp"
+#include "radixsort.hpp"
 #include "tensor.hpp"
 #include "field.hpp"
 #include "sparsefield.hpp"
@@ -48,6 +53,28 @@ using namespace std;
 using namespace chrono;
 
 
+// Sets all values of a field to random numbers in offset .. offset + 1
+template<typename FIELD>
+void fill_random(FIELD& field, data_t offset = 0) {
+	for (auto e : field)
+		e.second = rand() / (double)RAND_MAX + offset;
+}
+
+// Refines a sparse field to n random coords of the levels lo_level .. lo_level + levels - 1, returns the coords
+template<typename FIELD>
+vector<coord_t> random_sparse_field(FIELD& field, int n, level_t lo_level, int levels) {
+	typedef decltype(field.hcs) hcs_t;
+	vector<coord_t> coords;
+	for (int i = 0; i < n; i++) {
+		typename hcs_t::pos_t pos;
+		for (auto& p : pos)
+			p = rand() / (double)RAND_MAX;
+		coords.push_back(field.hcs.createFromPosition(lo_level + rand() % levels, pos));
+		field.refineTo(coords.back());
+	}
+	return coords;
+}
+
 // Write a 2D scalar field to a PGM. Scales automatically.
 // Level determines resolution.
 void write_pgm(string filename, ScalarField2 &field, level_t level) {
@@ -35,16 +35,12 @@ public:
 
 
 			auto coeff_cache_it = coeff_cache.find(coord);
-			typename FTYPE::coeff_map_t coeffs;
-			if (coeff_cache_it == coeff_cache.end()) {
-				coeffs = stencil(coord, x);
-				coeff_cache[coord] = coeffs;
-			} else
-				coeffs = coeff_cache_it->second;
-					//stencil(coord, x);
+			if (coeff_cache_it == coeff_cache.end())
+				coeff_cache_it = coeff_cache.insert(make_pair(coord, stencil(coord, x))).first;
+			typename FTYPE::coeff_map_t &coeffs = coeff_cache_it->second;
 			DTYPE &result_ = result.getDirect(coord);
 			result_ = coeffs[coord] * e.second;	// start w main diagonal
-			for (auto coeff : coeffs)
+			for (const auto &coeff : coeffs)
 				if (coeff.first != coord)
 					result_ += coeff.second * x.get(coeff.first);
 		}
@@ -56,19 +52,14 @@ public:
 template<typename DTYPE, typename FTYPE>
 class Solver {
 public:
+	// Deterministic SIMD / threaded reductions of numerics.hpp, b is interpolated where it lacks coords of a
 	data_t dot(FTYPE& a, FTYPE& b) {
-		data_t result = 0;
-		for (auto e : a) {	// dual iterator
-			result += e.second * b[e.first];
-		}
-		return result;
+		return ::dot(a, b);
 	}
 
+	// Squared norm
 	data_t norm(FTYPE& a) {
-		data_t result = 0;
-		for (auto e : a)
-			result += e.second * e.second;
-		return result;
+		return ::dot(a, a);
 	}
 
 	// A BiCGStab implementation
@@ -2,6 +2,21 @@
 
 // TEST1: HCS neighbor+GetPosition speed
 
+template<size_t dimensions>
+void check_coeffs(level_t max_level) {
+	HCS<dimensions> h;
+	for (coord_t c = 1; c <= h.CreateMaxLevel(max_level); c++) {
+		map<coord_t, data_t> merged;
+		for (auto coeff : h.getCoeffs(c))
+			merged[coeff.first] += coeff.second;
+		auto reference = h.getCoeffs2(c);
+		for (auto coeff : reference)
+			assert(merged[coeff.first] == coeff.second);
+		assert(merged.size() == reference.size());
+	}
+	cout << dimensions << "D getCoeffs() == getCoeffs2() up to level " << max_level << endl;
+}
+
 int main(int argc, char **argv) {
 
 	H2 h2;
@@ -118,4 +133,43 @@ int main(int argc, char **argv) {
 	cout.precision(20);
 	cout << "Level-8 coeff lookup " << count << " times took " << duration << "ms. Or " << int(count / (double)duration) << " lookups per ms. #" << (sum) << endl;
 
+	// getCoeffs() merged equals getCoeffs2() bit by bit, including coords near several boundaries
+	check_coeffs<2>(6);
+	check_coeffs<3>(4);
+	check_coeffs<4>(3);
+
+	// CoeffSet behaves like map<coord_t, data_t>, also after spilling to the heap
+	srand(1);
+	for (int i = 0; i < 1000; i++) {
+		CoeffSet<4> set, other;
+		map<coord_t, data_t> reference, reference_other;
+		int n = rand() % 12;
+		for (int j = 0; j < n; j++) {
+			coord_t key = rand() % 10;
+			set[key] += j;
+			reference[key] += j;
+			other[key + 5] = j;
+			reference_other[key + 5] = j;
+		}
+		set.insert(other.begin(), other.end());
+		reference.insert(reference_other.begin(), reference_other.end());
+		assert(set.size() == reference.size());
+		for (auto coeff : set)
+			assert(reference[coeff.first] == coeff.second);
+	}
+
+	t1 = high_resolution_clock::now();
+	c = h3.CreateMinLevel(6);
+	c_end = h3.CreateMaxLevel(6);
+	count = 0;
+	sum = 0;
+	for (; c <= c_end; c++) {
+		for (auto coeff : h3.getCoeffs2(c))
+			sum += coeff.second;
+		count++;
+	}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "Level-6 getCoeffs2 " << count << " times took " << duration << "ms. #" << (sum) << endl;
+
 }
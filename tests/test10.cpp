@@ -0,0 +1,479 @@
+#include "includes.hpp"
+
+// TEST10: Batched HCS neighbor, position and box kernels against their single-coord versions
+
+template<size_t dimensions>
+void check_neighbors(level_t level) {
+	HCS<dimensions> h;
+	coord_t c_lo = h.CreateMinLevel(level);
+	coord_t c_hi = h.CreateMaxLevel(level);
+	vector<coord_t> coords;
+	for (coord_t c = c_lo; c <= c_hi; c++)
+		coords.push_back(c);
+	coords.push_back(1);	// center, all neighbors are boundaries
+
+	vector<coord_t> batch(coords.size());
+	for (uint8_t direction = 0; direction < 2 * dimensions; direction++) {
+		h.getNeighbors(&coords[0], coords.size(), direction, &batch[0]);
+		for (size_t i = 0; i < coords.size(); i++)
+			if (batch[i] != h.getNeighbor(coords[i], direction)) {
+				cout << "getNeighbors mismatch " << dimensions << "D direction " << (int)direction << ": " << h.toString(coords[i]) << endl;
+				assert(false);
+			}
+	}
+	cout << dimensions << "D level " << level << ": getNeighbors() == getNeighbor() for " << coords.size() << " coords.\n";
+}
+
+// Reference for entry i of getMooreNeighborhood(): chain getNeighbor() over the dimensions, skipping boundary hits
+template<size_t dimensions, template<size_t> class Curve, uint32_t periodic>
+coord_t moore_reference(HCS<dimensions, Curve, periodic>& h, coord_t c, size_t i) {
+	const size_t center = (Pow3(dimensions) - 1) / 2;
+	size_t offsets = i < center ? i : i + 1;
+	coord_t current = c;
+	int boundary_direction = -1;
+	for (uint8_t dim = 0; dim < dimensions; dim++, offsets /= 3) {
+		if (offsets % 3 == 1)
+			continue;
+		uint8_t direction = 2 * dim + (offsets % 3 == 0);
+		coord_t ne = h.getNeighbor(current, direction);
+		if (h.IsBoundary(ne)) {
+			if (boundary_direction < 0)
+				boundary_direction = direction;
+		} else
+			current = ne;
+	}
+	if (boundary_direction >= 0)
+		current |= ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)boundary_direction << (HCS_COORD_BITS - 1 - dimensions));
+	return current;
+}
+
+template<size_t dimensions>
+void check_neighborhood(level_t level) {
+	HCS<dimensions> h;
+	for (coord_t c = h.CreateMinLevel(level); c <= h.CreateMaxLevel(level); c++) {
+		auto faces = h.getNeighborhood(c);
+		for (uint8_t direction = 0; direction < 2 * dimensions; direction++)
+			assert(faces[direction] == h.getNeighbor(c, direction));
+
+		auto moore = h.getMooreNeighborhood(c);
+		for (size_t i = 0; i < moore.size(); i++)
+			if (moore[i] != moore_reference(h, c, i)) {
+				cout << "getMooreNeighborhood mismatch " << dimensions << "D entry " << i << ": " << h.toString(c) << endl;
+				assert(false);
+			}
+	}
+	cout << dimensions << "D level " << level << ": getNeighborhood() and getMooreNeighborhood() match getNeighbor().\n";
+}
+
+// Batched position conversions against the single versions, AoS and SoA
+template<size_t dimensions>
+void check_positions(level_t level) {
+	typedef HCS<dimensions> H;
+	H h;
+	vector<typename H::pos_t> positions;
+	srand(7);
+	for (int i = 0; i < 1003; i++) {
+		typename H::pos_t p;
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			p[dim] = double(rand()) / RAND_MAX;
+		positions.push_back(p);
+	}
+	vector<coord_t> batch(positions.size());
+	h.createFromPositions(level, &positions[0], positions.size(), &batch[0]);
+	for (size_t i = 0; i < positions.size(); i++)
+		assert(batch[i] == h.createFromPosition(level, positions[i]));
+
+	vector<vector<data_t> > soa(dimensions, vector<data_t>(positions.size()));
+	array<const data_t*, dimensions> soa_in;
+	array<data_t*, dimensions> soa_out;
+	for (uint8_t dim = 0; dim < dimensions; dim++) {
+		for (size_t i = 0; i < positions.size(); i++)
+			soa[dim][i] = positions[i][dim];
+		soa_in[dim] = soa_out[dim] = &soa[dim][0];
+	}
+	vector<coord_t> batch_soa(positions.size());
+	h.createFromPositions(level, soa_in, positions.size(), &batch_soa[0]);
+	assert(batch_soa == batch);
+
+	// mixed levels, center and boundaries
+	for (level_t l = 0; l <= level; l++)
+		batch[l] = h.CreateMaxLevel(l);
+	batch[level + 1] = h.getNeighbor(batch[level], 0);
+	h.getPositions(&batch[0], batch.size(), &positions[0]);
+	h.getPositions(&batch[0], batch.size(), soa_out);
+	for (size_t i = 0; i < batch.size(); i++) {
+		auto p = h.getPosition(batch[i]);
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			if (fabs(positions[i][dim] - p[dim]) > 1e-15 || fabs(soa[dim][i] - p[dim]) > 1e-15) {
+				cout << "getPositions mismatch " << dimensions << "D: " << h.toString(batch[i]) << endl;
+				assert(false);
+			}
+	}
+	cout << dimensions << "D level " << level << ": createFromPositions() and getPositions() match the single versions.\n";
+}
+
+// rangesInBox() against a scan of the whole level
+template<size_t dimensions>
+void check_ranges(level_t level) {
+	typedef HCS<dimensions> H;
+	H h;
+	srand(9);
+	for (int i = 0; i < 200; i++) {
+		typename H::unscaled_t lo, hi;
+		for (uint8_t dim = 0; dim < dimensions; dim++) {
+			lo[dim] = rand() % (1 << level);
+			hi[dim] = lo[dim] + rand() % (1 << level);	// partly beyond the level
+		}
+		auto ranges = h.rangesInBox(level, lo, hi);
+		vector<coord_t> from_ranges, from_scan;
+		for (size_t r = 0; r < ranges.size(); r++) {
+			assert(ranges[r].first <= ranges[r].second);
+			assert(r == 0 || ranges[r - 1].second + 1 < ranges[r].first);	// sorted and merged
+			for (coord_t c = ranges[r].first; c <= ranges[r].second; c++)
+				from_ranges.push_back(c);
+		}
+		for (coord_t c = h.CreateMinLevel(level); c <= h.CreateMaxLevel(level); c++) {
+			auto u = h.getUnscaled(c);
+			bool inside = true;
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				inside &= u[dim] >= lo[dim] && u[dim] <= hi[dim];
+			if (inside)
+				from_scan.push_back(c);
+		}
+		assert(from_ranges == from_scan);
+	}
+	cout << dimensions << "D level " << level << ": rangesInBox() matches a scan of the level.\n";
+}
+
+// Linear indices of all levels up to level: dense, in coord order and the batches equal the single versions
+template<size_t dimensions>
+void check_indices(level_t level) {
+	typedef HCS<dimensions> H;
+	vector<coord_t> coords(1, 1);
+	for (level_t l = 1; l <= level; l++)
+		for (coord_t c = H::CreateMinLevel(l); c <= H::CreateMaxLevel(l); c++)
+			coords.push_back(c);
+	vector<size_t> indices(coords.size());
+	vector<coord_t> back(coords.size());
+	H::coords2indices(&coords[0], coords.size(), &indices[0]);
+	H::indices2coords(&indices[0], indices.size(), &back[0]);
+	for (size_t i = 0; i < coords.size(); i++)
+		assert(indices[i] == i && H::coord2index(coords[i]) == i && H::index2coord(i) == coords[i] && back[i] == coords[i]);
+	cout << dimensions << "D level " << level << ": " << coords.size() << " linear indices OK.\n";
+}
+
+// Random walks of a Cursor against getNeighbor(), ReduceLevel() and createFromUnscaled()
+template<typename H>
+void check_cursor(level_t level) {
+	H h;
+	const size_t dimensions = H::GetDimensions();
+	srand(10);
+	for (int walk = 0; walk < 100; walk++) {
+		coord_t c = h.CreateMinLevel(level) + rand() % (h.CreateMaxLevel(level) - h.CreateMinLevel(level) + 1);
+		auto cursor = h.getCursor(c);
+		for (int i = 0; i < 1000; i++) {
+			assert(cursor.coord() == c && cursor.getLevel() == h.GetLevel(c) && cursor.getUnscaled() == h.getUnscaled(c));
+			int move = rand() % (2 * dimensions + 2);
+			if (move < 2 * dimensions) {
+				coord_t ne = h.getNeighbor(c, move);
+				assert(cursor.neighbor(move) == ne);
+				assert(cursor.step(move) == !h.IsBoundary(ne));
+				if (!h.IsBoundary(ne))
+					c = ne;
+			} else if (move == 2 * dimensions) {
+				cursor.parent();
+				c = h.ReduceLevel(c);
+			} else if (h.GetLevel(c) < level + 2) {
+				uint8_t part = rand() % h.parts;
+				cursor.child(part);
+				auto unscaled = h.getUnscaled(c);
+				for (uint8_t dim = 0; dim < dimensions; dim++)
+					unscaled[dim] = 2 * unscaled[dim] + ((part >> dim) & 1);
+				c = h.createFromUnscaled(h.GetLevel(c) + 1, unscaled);
+			}
+		}
+	}
+	cout << dimensions << "D level " << level << ": Cursor walks match getNeighbor().\n";
+}
+
+// Periodic dimensions: every neighbor method against the wrapped unscaled position
+template<typename H>
+void check_periodic(level_t level) {
+	H h;
+	const size_t dimensions = H::GetDimensions();
+	const unscaled_coord_t max_coord = (unscaled_coord_t)1 << level;
+	vector<coord_t> coords;
+	for (coord_t c = h.CreateMinLevel(level); c <= h.CreateMaxLevel(level); c++)
+		coords.push_back(c);
+	vector<coord_t> batch(coords.size());
+	for (uint8_t direction = 0; direction < 2 * dimensions; direction++) {
+		uint8_t dim = direction >> 1;
+		h.getNeighbors(&coords[0], coords.size(), direction, &batch[0]);
+		for (size_t i = 0; i < coords.size(); i++) {
+			coord_t c = coords[i];
+			auto unscaled = h.getUnscaled(c);
+			unscaled_coord_t u = unscaled[dim] + (direction & 1 ? -1 : 1);
+			coord_t expected;
+			if (u < max_coord || h.IsPeriodic(dim)) {
+				unscaled[dim] = u & (max_coord - 1);
+				expected = h.createFromUnscaled(level, unscaled);
+			} else
+				expected = c | ((coord_t)1 << (HCS_COORD_BITS - 1)) | ((coord_t)direction << (HCS_COORD_BITS - 1 - dimensions));
+			auto cursor = h.getCursor(c);
+			assert(h.getNeighbor(c, direction) == expected && h.getNeighbor2(c, direction) == expected);
+			assert(batch[i] == expected && h.getNeighborhood(c)[direction] == expected && cursor.neighbor(direction) == expected);
+			assert(cursor.step(direction) == !h.IsBoundary(expected) && (h.IsBoundary(expected) || cursor.coord() == expected));
+		}
+	}
+	// Moore neighborhood against chained getNeighbor()
+	for (auto c : coords) {
+		auto moore = h.getMooreNeighborhood(c);
+		for (size_t i = 0; i < moore.size(); i++)
+			assert(moore[i] == moore_reference(h, c, i));
+		// interpolation wraps too: no boundary coords along periodic dimensions
+		for (auto coeff : h.getCoeffs(c))
+			assert(!h.IsBoundary(coeff.first) || !h.IsPeriodic(h.GetBoundaryDirection(coeff.first) >> 1));
+		map<coord_t, data_t> merged;
+		for (auto coeff : h.getCoeffs(c))
+			merged[coeff.first] += coeff.second;
+		for (auto coeff : h.getCoeffs2(c))
+			assert(fabs(merged[coeff.first] - coeff.second) < 1e-14);
+	}
+	cout << dimensions << "D level " << level << " periodic " << h.IsPeriodic(0) << h.IsPeriodic(1) << ": neighbors wrap around.\n";
+}
+
+const char* morton_names[] = { "pdep", "avx512", "magic", "lut" };
+
+// All Morton methods the CPU supports against a bit-by-bit reference
+template<size_t dimensions>
+void check_morton() {
+	const level_t bits = Morton<dimensions>::max_bits < 32 ? Morton<dimensions>::max_bits : 32;
+	morton_method_t original = MortonMethod();
+	for (int m = 0; m < 4; m++) {
+		if (!SetMortonMethod(morton_method_t(m)))
+			continue;
+		srand(42);
+		for (int i = 0; i < 100000; i++) {
+			uint32_t value = ((uint32_t(rand()) << 16) ^ uint32_t(rand())) & (uint32_t)((((uint64_t)1) << bits) - 1);
+			coord_t dilated = 0;
+			for (level_t b = 0; b < bits; b++)
+				dilated |= (coord_t)((value >> b) & 1) << (b * dimensions);
+			if (Morton<dimensions>::Dilate(value) != dilated || Morton<dimensions>::Compact(dilated) != value) {
+				cout << "Morton " << morton_names[m] << " " << dimensions << "D mismatch for " << value << endl;
+				assert(false);
+			}
+		}
+		cout << "Morton " << morton_names[m] << " " << dimensions << "D OK\n";
+	}
+	SetMortonMethod(original);
+}
+
+int main(int argc, char **argv) {
+
+#if defined(__AVX512F__)
+	printf("Compiled with AVX-512!\n");
+#elif defined(__AVX2__)
+	printf("Compiled with AVX2!\n");
+#else
+	printf("NO AVX\n");
+#endif
+
+	cout << "Morton method: " << morton_names[MortonMethod()] << endl;
+	check_morton<1>();
+	check_morton<2>();
+	check_morton<3>();
+	check_morton<4>();
+	check_morton<5>();
+
+	check_neighbors<1>(9);
+	check_neighbors<2>(5);
+	check_neighbors<3>(4);
+	check_neighbors<4>(3);
+
+	check_positions<1>(20);
+	check_positions<2>(12);
+	check_positions<3>(9);
+	check_positions<4>(6);
+
+	check_ranges<1>(7);
+	check_ranges<2>(5);
+	check_ranges<3>(4);
+	check_ranges<4>(3);
+
+	check_cursor<HCS<1> >(8);
+	check_cursor<HCS<2> >(5);
+	check_cursor<HCS<3> >(4);
+	check_cursor<HCS<3, HilbertCurve> >(4);
+	check_cursor<HCS<4> >(2);
+
+	check_periodic<HCS<1, MortonCurve, 1> >(6);
+	check_periodic<HCS<2, MortonCurve, 1> >(4);
+	check_periodic<HCS<2, MortonCurve, 3> >(4);
+	check_periodic<HCS<3, MortonCurve, 6> >(3);
+	check_periodic<HCS<2, HilbertCurve, 2> >(4);
+	check_periodic<HCS<3, HilbertCurve, 7> >(3);
+
+	check_indices<1>(12);
+	check_indices<2>(7);
+	check_indices<3>(5);
+	check_indices<4>(4);
+	check_indices<5>(3);
+
+	check_neighborhood<1>(1);
+	check_neighborhood<1>(6);
+	check_neighborhood<2>(4);
+	check_neighborhood<3>(3);
+	check_neighborhood<4>(2);
+
+	// Speed of a full 3D stencil sweep over a level
+	H3 h3;
+	const level_t level = 7;
+	vector<coord_t> coords;
+	for (coord_t c = h3.CreateMinLevel(level); c <= h3.CreateMaxLevel(level); c++)
+		coords.push_back(c);
+	vector<coord_t> neighbors(coords.size());
+	coord_t sum = 0;
+
+	auto t1 = high_resolution_clock::now();
+	for (int i = 0; i < 10; i++)
+		for (uint8_t direction = 0; direction < 6; direction++)
+			for (size_t j = 0; j < coords.size(); j++)
+				sum += neighbors[j] = h3.getNeighbor(coords[j], direction);
+	auto t2 = high_resolution_clock::now();
+	auto duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getNeighbor() of " << 60 * coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	for (int i = 0; i < 10; i++)
+		for (uint8_t direction = 0; direction < 6; direction++) {
+			h3.getNeighbors(&coords[0], coords.size(), direction, &neighbors[0]);
+			sum += neighbors[i];
+		}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getNeighbors() of " << 60 * coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	// Point cloud conversion: single vs. batched
+	vector<H3::pos_t> positions(coords.size());
+	t1 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		positions[j] = h3.getPosition(coords[j]);
+	for (size_t j = 0; j < coords.size(); j++)
+		sum += h3.createFromPosition(level, positions[j]) - coords[j];
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getPosition() + createFromPosition() of " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	h3.getPositions(&coords[0], coords.size(), &positions[0]);
+	h3.createFromPositions(level, &positions[0], positions.size(), &neighbors[0]);
+	t2 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		sum += neighbors[j] - coords[j];
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getPositions() + createFromPositions() of " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	// Line sweeps along X from every coord of the YZ plane: getNeighbor2() vs. Cursor
+	const unscaled_coord_t width = (unscaled_coord_t)1 << level;
+	t1 = high_resolution_clock::now();
+	for (unscaled_coord_t y = 0; y < width; y++)
+		for (unscaled_coord_t z = 0; z < width; z++) {
+			coord_t c = h3.createFromUnscaled(level, {{0, y, z}});
+			for (unscaled_coord_t x = 1; x < width; x++)
+				sum += c = h3.getNeighbor2(c, 0);
+		}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getNeighbor2() line sweeps over " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	for (unscaled_coord_t y = 0; y < width; y++)
+		for (unscaled_coord_t z = 0; z < width; z++) {
+			H3::Cursor cursor(level, {{0, y, z}});
+			while (cursor.step(0))
+				sum += cursor.coord();
+		}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "Cursor line sweeps over " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	// Storage index round trip: single vs. batched
+	vector<size_t> indices(coords.size());
+	t1 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		sum += h3.index2coord(h3.coord2index(coords[j])) - coords[j];
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<microseconds>(t2-t1).count();
+	cout << "index2coord(coord2index()) of " << coords.size() << " coords took " << duration << "us. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	h3.coords2indices(&coords[0], coords.size(), &indices[0]);
+	h3.indices2coords(&indices[0], indices.size(), &neighbors[0]);
+	t2 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		sum += neighbors[j] - coords[j];
+	duration = duration_cast<microseconds>(t2-t1).count();
+	cout << "indices2coords(coords2indices()) of " << coords.size() << " coords took " << duration << "us. #" << (int)(sum & 0xff) << endl;
+
+	// A 32^3 box: scan of the level vs. its intervals
+	H3::unscaled_t lo = {{40, 50, 60}}, hi = {{71, 81, 91}};
+	t1 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++) {
+		auto u = h3.getUnscaled(coords[j]);
+		if (u[0] >= lo[0] && u[0] <= hi[0] && u[1] >= lo[1] && u[1] <= hi[1] && u[2] >= lo[2] && u[2] <= hi[2])
+			sum += coords[j];
+	}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<microseconds>(t2-t1).count();
+	cout << "Box by scanning " << coords.size() << " coords took " << duration << "us. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	auto ranges = h3.rangesInBox(level, lo, hi);
+	for (auto range : ranges)
+		for (coord_t c = range.first; c <= range.second; c++)
+			sum += c;
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<microseconds>(t2-t1).count();
+	cout << "Box by " << ranges.size() << " rangesInBox() intervals took " << duration << "us. #" << (int)(sum & 0xff) << endl;
+
+	// Encode / decode round trip speed of each Morton method
+	morton_method_t original = MortonMethod();
+	for (int m = 0; m < 4; m++) {
+		if (!SetMortonMethod(morton_method_t(m)))
+			continue;
+		t1 = high_resolution_clock::now();
+		for (size_t j = 0; j < coords.size(); j++) {
+			coord_t c = h3.createFromUnscaled(level, h3.getUnscaled(coords[j]));
+			assert(c == coords[j]);
+			sum += c;
+		}
+		t2 = high_resolution_clock::now();
+		duration = duration_cast<milliseconds>(t2-t1).count();
+		cout << "Morton " << morton_names[m] << ": " << coords.size() << " decode + encode took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+	}
+	SetMortonMethod(original);
+
+	// 27-point stencil: 26 chained getNeighbor() vs. one getMooreNeighborhood()
+	t1 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		for (int z = 0; z < 3; z++)
+			for (int y = 0; y < 3; y++)
+				for (int x = 0; x < 3; x++) {
+					coord_t c = coords[j];
+					if (x != 1) c = h3.getNeighbor(c, x == 0 ? 1 : 0);
+					if (y != 1 && !h3.IsBoundary(c)) c = h3.getNeighbor(c, y == 0 ? 3 : 2);
+					if (z != 1 && !h3.IsBoundary(c)) c = h3.getNeighbor(c, z == 0 ? 5 : 4);
+					sum += c;
+				}
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "Chained getNeighbor() 27-point stencils for " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+
+	t1 = high_resolution_clock::now();
+	for (size_t j = 0; j < coords.size(); j++)
+		for (auto ne : h3.getMooreNeighborhood(coords[j]))
+			sum += ne;
+	t2 = high_resolution_clock::now();
+	duration = duration_cast<milliseconds>(t2-t1).count();
+	cout << "getMooreNeighborhood() for " << coords.size() << " coords took " << duration << "ms. #" << (int)(sum & 0xff) << endl;
+}
@@ -0,0 +1,50 @@
+#include "includes.hpp"
+
+// TEST11: Round trips at the deepest level of the configured coordinate width.
+// The makefile also builds test11_32 and test11_128 with -DHCS_COORD_WIDTH=32 / 128.
+
+template<size_t dimensions>
+void check_width() {
+	typedef HCS<dimensions> H;
+	H h;
+	const level_t level = H::max_level;
+	srand(11);
+	for (int i = 0; i < 100000; i++) {
+		typename H::unscaled_t unscaled;
+		for (uint8_t dim = 0; dim < dimensions; dim++) {
+			unscaled[dim] = 0;
+			for (int r = 0; r < 5; r++)
+				unscaled[dim] = (unscaled[dim] << 15) ^ (unscaled_coord_t)rand();
+			unscaled[dim] &= ((unscaled_coord_t)1 << level) - 1;
+		}
+		coord_t c = h.createFromUnscaled(level, unscaled);
+		assert(h.GetLevel(c) == level);
+		assert(h.getUnscaled(c) == unscaled);
+		for (uint8_t direction = 0; direction < 2 * dimensions; direction++)
+			assert(h.getNeighbor(c, direction) == h.getNeighbor2(c, direction));
+		// positions resolve the level as long as data_t has the mantissa bits
+		if (level < 50)
+			assert(h.createFromPosition(level, h.getPosition(c)) == c);
+	}
+
+	// Level transitions and linear indices up to the deepest level
+	for (level_t l = 1; l < level; l++) {
+		coord_t c = h.CreateMaxLevel(l);
+		bool stepped = h.inc(c);
+		assert(stepped && c == h.CreateMinLevel(l + 1));
+		stepped = h.dec(c);
+		assert(stepped && c == h.CreateMaxLevel(l));
+		if (l < 8)
+			assert(h.index2coord(h.coord2index(c)) == c);
+	}
+	cout << dimensions << "D: level " << level << " round trips OK\n";
+}
+
+int main(int argc, char **argv) {
+	cout << "Coordinate width: " << HCS_COORD_BITS << " bit\n";
+	check_width<1>();
+	check_width<2>();
+	check_width<3>();
+	check_width<4>();
+	check_width<5>();
+}
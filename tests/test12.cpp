@@ -0,0 +1,159 @@
+#include "includes.hpp"
+
+// TEST12: HCS with Hilbert order (HCS<D, HilbertCurve>) against the default Morton order.
+// Both must describe the same cells, only the linear order within a level differs.
+
+template<size_t dimensions>
+using HilbertHCS = HCS<dimensions, HilbertCurve>;
+
+template<size_t dimensions>
+int distance(const array<unscaled_coord_t, dimensions>& a, const array<unscaled_coord_t, dimensions>& b) {
+	int result = 0;
+	for (uint8_t dim = 0; dim < dimensions; dim++)
+		result += a[dim] > b[dim] ? a[dim] - b[dim] : b[dim] - a[dim];
+	return result;
+}
+
+// Describe a coord independent of the curve: level and unscaled position, boundaries by direction and origin
+template<typename H>
+string cell(H& h, coord_t c) {
+	stringstream result;
+	if (h.IsBoundary(c)) {
+		result << "B" << (int)h.GetBoundaryDirection(c) << " ";
+		c = h.removeBoundary(c);
+	}
+	result << (int)h.GetLevel(c) << ":";
+	for (auto u : h.getUnscaled(c))
+		result << " " << u;
+	return result.str();
+}
+
+template<size_t dimensions>
+void check_curve(level_t level) {
+	HilbertHCS<dimensions> h;
+	HCS<dimensions> m;
+	typename HCS<dimensions>::unscaled_t previous;
+	for (coord_t c = h.CreateMinLevel(level); c <= h.CreateMaxLevel(level); c++) {
+		auto unscaled = h.getUnscaled(c);
+		assert(h.createFromUnscaled(level, unscaled) == c);
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			assert(h.getSingleUnscaled(c, dim) == unscaled[dim]);
+		// prefix property: the parent is the cell that contains c
+		auto parent = h.getUnscaled(h.ReduceLevel(c));
+		for (uint8_t dim = 0; dim < dimensions; dim++)
+			assert(parent[dim] == unscaled[dim] >> 1);
+		// no jumps along the curve
+		if (c != h.CreateMinLevel(level))
+			assert(distance<dimensions>(previous, unscaled) == 1);
+		previous = unscaled;
+
+		coord_t mc = m.createFromUnscaled(level, unscaled);
+		auto faces = h.getNeighborhood(c);
+		for (uint8_t direction = 0; direction < 2 * dimensions; direction++) {
+			coord_t ne = h.getNeighbor(c, direction);
+			assert(ne == h.getNeighbor2(c, direction) && ne == faces[direction]);
+			assert(cell(h, ne) == cell(m, m.getNeighbor(mc, direction)));
+		}
+		auto moore = h.getMooreNeighborhood(c);
+		auto moore_m = m.getMooreNeighborhood(mc);
+		for (size_t i = 0; i < moore.size(); i++)
+			assert(cell(h, moore[i]) == cell(m, moore_m[i]));
+
+		// interpolation: same cells, same weights
+		auto coeffs = h.getCoeffs(c);
+		auto coeffs2 = h.getCoeffs2(c);
+		map<string, data_t> merged, reference;
+		for (auto& coeff : coeffs)
+			merged[cell(h, coeff.first)] += coeff.second;
+		for (auto& coeff : coeffs2)
+			assert(fabs(merged[cell(h, coeff.first)] - coeff.second) < 1e-14);
+		for (auto& coeff : m.getCoeffs2(mc))
+			reference[cell(m, coeff.first)] = coeff.second;
+		for (auto& coeff : merged)
+			if (coeff.second != 0)
+				assert(fabs(reference[coeff.first] - coeff.second) < 1e-14);
+		assert(coeffs2.size() == reference.size());
+	}
+
+	// the box ranges cover exactly the box
+	typename HCS<dimensions>::unscaled_t lo, hi;
+	for (uint8_t dim = 0; dim < dimensions; dim++) {
+		lo[dim] = dim + 1;
+		hi[dim] = ((unscaled_coord_t)1 << level) - 2 - dim;
+	}
+	size_t n = 0;
+	for (auto& range : h.rangesInBox(level, lo, hi))
+		for (coord_t c = range.first; c <= range.second; c++, n++) {
+			auto unscaled = h.getUnscaled(c);
+			for (uint8_t dim = 0; dim < dimensions; dim++)
+				assert(unscaled[dim] >= lo[dim] && unscaled[dim] <= hi[dim]);
+		}
+	size_t volume = 1;
+	for (uint8_t dim = 0; dim < dimensions; dim++)
+		volume *= hi[dim] - lo[dim] + 1;
+	assert(n == volume);
+	cout << dimensions << "D level " << (int)level << ": Hilbert cells match Morton cells.\n";
+}
+
+// Fields give the same values in both orders, queried from min_level up to level 10
+template<typename MFIELD, typename HFIELD>
+void check_field(MFIELD& fm, HFIELD& fh, level_t min_level) {
+	typedef HCS<2> M;
+	typedef HilbertHCS<2> H;
+	M m;
+	H h;
+	assert(fm.nElements() == fh.nElements());
+	for (auto e : fm) {
+		M::pos_t pos = m.getPosition(e.first);
+		e.second = sin(5 * pos[0]) * pos[1];
+	}
+	for (auto e : fh) {
+		H::pos_t pos = h.getPosition(e.first);
+		e.second = sin(5 * pos[0]) * pos[1];
+	}
+	fm.propagate();
+	fh.propagate();
+	for (int i = 0; i < 20000; i++) {
+		M::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		level_t l = min_level + rand() % (11 - min_level);
+		assert(fabs(fm.get(m.createFromPosition(l, pos)) - fh.get(h.createFromPosition(l, pos))) < 1e-12);
+	}
+	cout << "Field with " << fm.nElements() << " elements: Hilbert == Morton.\n";
+}
+
+// Sum the face neighbors of a whole level, in the order of the curve
+template<typename H>
+void time_neighbors(level_t level, const char* name) {
+	H h;
+	coord_t sum = 0;
+	auto t1 = high_resolution_clock::now();
+	for (coord_t c = h.CreateMinLevel(level); c <= h.CreateMaxLevel(level); c++)
+		for (auto ne : h.getNeighborhood(c))
+			sum += ne;
+	auto t2 = high_resolution_clock::now();
+	cout << name << " getNeighborhood() level " << (int)level << ": " << duration_cast<milliseconds>(t2 - t1).count() << "ms (" << (int)(sum & 0xff) << ")\n";
+}
+
+int main(int argc, char **argv) {
+	check_curve<1>(6);
+	check_curve<2>(1);
+	check_curve<2>(4);
+	check_curve<3>(3);
+	check_curve<4>(2);
+	// random structure
+	SparseField<data_t, HCS<2> > sm(4);
+	SparseField<data_t, HilbertHCS<2> > sh(4);
+	srand(12);
+	for (int i = 0; i < 2000; i++) {
+		HCS<2>::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		level_t l = 5 + rand() % 4;
+		sm.refineTo(sm.hcs.createFromPosition(l, pos));
+		sh.refineTo(sh.hcs.createFromPosition(l, pos));
+	}
+	check_field(sm, sh, 1);
+	DenseField<data_t, HCS<2> > dm(7);
+	DenseField<data_t, HilbertHCS<2> > dh(7);
+	check_field(dm, dh, 1);
+	time_neighbors<HCS<3> >(6, "Morton ");
+	time_neighbors<HilbertHCS<3> >(6, "Hilbert");
+}
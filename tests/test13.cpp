@@ -0,0 +1,83 @@
+#include "includes.hpp"
+
+// TEST13: RadixSort against std::sort with greater<coord_t>, and bulk refinement of a SparseField
+
+// Random coords of levels lo..hi in dimensions D
+vector<coord_t> random_coords(size_t n, size_t dimensions, level_t lo, level_t hi) {
+	vector<coord_t> result(n);
+	for (auto& c : result) {
+		level_t level = lo + rand() % (hi - lo + 1);
+		c = 0;
+		for (int r = 0; r < 5; r++)
+			c = (c << 15) ^ (coord_t)rand();
+		c = (c & (((coord_t)1 << (level * dimensions)) - 1)) | ((coord_t)1 << (level * dimensions));
+	}
+	return result;
+}
+
+void check_sort(size_t n, level_t lo, level_t hi, unsigned threads) {
+	vector<coord_t> keys = random_coords(n, 3, lo, hi);
+	vector<pair<coord_t, uint32_t> > reference(n);
+	vector<uint32_t> payload(n);
+	for (size_t i = 0; i < n; i++) {
+		reference[i] = make_pair(keys[i], (uint32_t)i);
+		payload[i] = i;
+	}
+	// stable: equal keys keep their payload order
+	stable_sort(reference.begin(), reference.end(), [](const pair<coord_t, uint32_t>& a, const pair<coord_t, uint32_t>& b) {
+		return a.first > b.first;
+	});
+	vector<coord_t> keys_only = keys;
+	RadixSort(&keys[0], &payload[0], n, threads);
+	RadixSort(&keys_only[0], n, threads);
+	for (size_t i = 0; i < n; i++)
+		assert(keys[i] == reference[i].first && payload[i] == reference[i].second && keys_only[i] == keys[i]);
+	cout << "RadixSort of " << n << " coords, levels " << (int)lo << "-" << (int)hi << ", " << threads << " threads OK\n";
+}
+
+int main(int argc, char **argv) {
+	srand(13);
+	check_sort(0, 1, 1, 1);
+	check_sort(1, 1, 1, 1);
+	check_sort(1000, 5, 5, 1);
+	check_sort(100000, 1, 8, 1);
+	check_sort(300000, 3, 12, 4);
+	check_sort(300000, 7, 7, 3);
+
+	// Speed for a million particle keys
+	const size_t n = 1 << 20;
+	vector<coord_t> keys = random_coords(n, 3, 6, 10);
+	vector<coord_t> sorted = keys;
+	auto t1 = high_resolution_clock::now();
+	sort(sorted.begin(), sorted.end(), greater<coord_t>());
+	auto t2 = high_resolution_clock::now();
+	cout << "std::sort of " << n << " coords took " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	for (unsigned threads : {1, 0}) {
+		vector<coord_t> radix = keys;
+		t1 = high_resolution_clock::now();
+		RadixSort(&radix[0], n, threads);
+		t2 = high_resolution_clock::now();
+		assert(radix == sorted);
+		cout << "RadixSort (" << (threads ? "single thread" : "all threads") << ") of " << n << " coords took " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	}
+
+	// Bulk refinement gives the same structure as refining one by one
+	H3 h3;
+	vector<coord_t> refinements = random_coords(100000, 3, 5, 9);
+	SparseScalarField3 single, bulk;
+	t1 = high_resolution_clock::now();
+	for (auto c : refinements)
+		single.refineTo(c);
+	t2 = high_resolution_clock::now();
+	cout << "refineTo() one by one: " << single.nElements() << " elements in " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	bulk.refineTo(&refinements[0], refinements.size());
+	t2 = high_resolution_clock::now();
+	cout << "refineTo() sorted bulk: " << bulk.nElements() << " elements in " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	assert(single.nElements() == bulk.nElements());
+	auto it_bulk = bulk.begin();
+	for (auto it = single.begin(); it != single.end(); ++it, ++it_bulk) {
+		assert((*it).first == (*it_bulk).first);
+		assert(single.isTop((*it).first) == bulk.isTop((*it_bulk).first));
+	}
+}
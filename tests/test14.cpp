@@ -0,0 +1,131 @@
+#include "includes.hpp"
+
+// TEST14: Field iteration with for_each() against the virtual iterator and a loop over a std::vector
+
+// for_each(top_only, level) visits the coords of begin(top_only, level) in the same order
+template<typename FIELD>
+void check_for_each(FIELD& f, bool top_only, int level) {
+	vector<coord_t> coords;
+	f.for_each(top_only, level, [&coords](coord_t c, data_t& v) { coords.push_back(c); });
+	size_t i = 0;
+	for (auto it = f.begin(top_only, level); it != f.end(); ++it, ++i)
+		assert(i < coords.size() && (*it).first == coords[i]);
+	assert(i == coords.size());
+}
+
+// levels(lo, hi, descending) covers the coords of for_each(false, level) for lo <= level <= hi, span by span in
+// coord order, with the values and top flags of the field
+template<typename FIELD>
+void check_levels(FIELD& f, int lo, int hi, bool descending) {
+	vector<coord_t> expected, spans;
+	for (int level = lo; level <= hi; level++)
+		f.for_each(false, level, [&expected](coord_t c, data_t& v) { expected.push_back(c); });
+	coord_t previous = descending ? numeric_limits<coord_t>::max() : 0;
+	for (auto& span : f.levels(lo, hi, descending)) {
+		assert(descending ? span.end < previous : span.start > previous);
+		previous = descending ? span.start : span.end;
+		for (size_t i = 0; i < span.size(); i++) {
+			coord_t c = span.coord(i);
+			assert(&span[i] == &f.getDirect(c) && span.isTop(i) == f.isTop(c) && f.hcs.GetLevel(c) == span.level);
+			spans.push_back(c);
+		}
+	}
+	sort(expected.begin(), expected.end());
+	sort(spans.begin(), spans.end());
+	assert(spans == expected);
+}
+
+// Fill, scale and sum a field both ways
+template<typename FIELD>
+void time_field(FIELD& f, const char* name) {
+	check_for_each(f, false, -1);
+	check_for_each(f, true, -1);
+	for (int level = 0; level <= f.getHighestLevel(); level++) {
+		check_for_each(f, false, level);
+		check_for_each(f, true, level);
+		check_levels(f, level, level, false);
+	}
+	check_levels(f, 0, f.getHighestLevel(), false);
+	check_levels(f, 0, f.getHighestLevel(), true);
+	check_levels(f, 2, 4, true);
+
+	const int n_runs = 10;
+	data_t sum_it = 0, sum_fe = 0;
+	auto t1 = high_resolution_clock::now();
+	for (int r = 0; r < n_runs; r++) {
+		for (auto e : f)
+			e.second = data_t((e.first & 0xff) + 1);
+		for (auto e : f)
+			e.second *= 0.5;
+		for (auto e : f)
+			sum_it += e.second;
+	}
+	auto t2 = high_resolution_clock::now();
+	cout << name << " iterator: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	for (int r = 0; r < n_runs; r++) {
+		f.for_each([](coord_t c, data_t& v) { v = data_t((c & 0xff) + 1); });
+		f *= 0.5;
+		f.for_each([&sum_fe](coord_t c, data_t& v) { sum_fe += v; });
+	}
+	t2 = high_resolution_clock::now();
+	cout << name << " for_each: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	assert(sum_it == sum_fe);
+
+	// operators agree with the virtual fallbacks of Field
+	FIELD g = f;
+	Field<data_t, H3>& base = g;
+	g += 1.0;
+	g.Field<data_t, H3>::operator-=(1.0);
+	g *= f;
+	base.Field<data_t, H3>::operator/=(f);
+	FIELD h = 2.0 - f;
+	h.template convert<data_t>(g, [](coord_t c, ScalarField3& s)->data_t { return s.get(c) * 2; });
+	for (auto e : f)
+		assert(g[e.first] == e.second && (!f.isTop(e.first) || h[e.first] == 2 * e.second));
+
+	// Interpolated reads, inlined lookups of get() against the virtual ones of Field::get(coord, result)
+	g.propagate();
+	vector<coord_t> reads;
+	for (int i = 0; i < 50000; i++) {
+		H3::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		reads.push_back(f.hcs.createFromPosition(2 + rand() % 8, pos));
+	}
+	data_t sum_virtual = 0, sum_inline = 0;
+	t1 = high_resolution_clock::now();
+	for (auto c : reads)
+		base.get(c, sum_virtual);
+	t2 = high_resolution_clock::now();
+	cout << name << " virtual get(): " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	for (auto c : reads)
+		sum_inline += g.get(c);
+	t2 = high_resolution_clock::now();
+	cout << name << " inlined get(): " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	assert(fabs(sum_virtual - sum_inline) <= 1e-9 * fabs(sum_virtual));
+}
+
+int main(int argc, char **argv) {
+	DenseScalarField3 dense(7);
+	time_field(dense, "Dense ");
+
+	SparseScalarField3 sparse;
+	srand(14);
+	random_sparse_field(sparse, 20000, 4, 4);
+	time_field(sparse, "Sparse");
+
+	// The same loops over a plain vector of the dense size
+	vector<data_t> v(dense.nElements());
+	data_t sum = 0;
+	auto t1 = high_resolution_clock::now();
+	for (int r = 0; r < 10; r++) {
+		for (size_t i = 0; i < v.size(); i++)
+			v[i] = data_t((i + 1) & 0xff);
+		for (auto& x : v)
+			x *= 0.5;
+		for (auto x : v)
+			sum += x;
+	}
+	auto t2 = high_resolution_clock::now();
+	cout << "vector: " << duration_cast<milliseconds>(t2 - t1).count() << "ms (" << (sum > 0) << ").\n";
+}
@@ -0,0 +1,107 @@
+#include "includes.hpp"
+
+// TEST15: Lazy field expressions against the same arithmetic with explicit temporary fields
+
+// Compares expressions with step by step compound ops, rhs may have another structure than lhs (interpolation)
+template<typename FIELD>
+void check_expressions(FIELD& lhs, FIELD& rhs, const char* name) {
+	const data_t alpha = 0.37;
+	FIELD s = lhs, reference = lhs, tmp = rhs;
+
+	s = lhs - alpha * rhs;
+	tmp *= alpha;
+	reference -= static_cast<Field<data_t, H2>&>(tmp);
+	for (auto e : s)
+		assert(fabs(e.second - reference[e.first]) < 1e-12);
+
+	// constructed from an expression, with the structure of its first operand of the same type
+	FIELD c = -(lhs + rhs) / 2. + 1. - lhs * rhs;
+	assert(c.nElements() == lhs.nElements());
+	for (auto e : c) {
+		data_t l = lhs.get(e.first), r = rhs.get(e.first);
+		assert(fabs(e.second - (-(l + r) / 2. + 1. - l * r)) < 1e-12);
+	}
+
+	// compound ops with expressions, the target as operand
+	s = lhs;
+	s += 2. * s - rhs;
+	s *= 1. / lhs;
+	for (auto e : s) {
+		data_t l = lhs.get(e.first), r = rhs.get(e.first);
+		assert(fabs(e.second - (3. * l - r) / l) < 1e-12);
+	}
+	cout << name << ": expressions OK.\n";
+}
+
+// One BiCGStab line, s = r - alpha * v, as expression and with a temporary field
+template<typename FIELD>
+void time_expression(FIELD& r, FIELD& v, const char* name) {
+	const int n_runs = 20;
+	const data_t alpha = 0.37;
+	FIELD s = r;
+	auto t1 = high_resolution_clock::now();
+	for (int i = 0; i < n_runs; i++) {
+		FIELD tmp = v;
+		tmp *= alpha;
+		s = r;
+		s -= static_cast<Field<data_t, H2>&>(tmp);
+	}
+	auto t2 = high_resolution_clock::now();
+	cout << name << " s = r - alpha * v with temporary: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	for (int i = 0; i < n_runs; i++)
+		s = r - alpha * v;
+	t2 = high_resolution_clock::now();
+	cout << name << " s = r - alpha * v as expression: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+}
+
+// a += b for fields of different structure: walking both bucket maps against one get() per coord of a
+template<typename FIELD, typename FIELD2>
+void time_merge(FIELD& a, FIELD2& b, const char* name) {
+	const int n_runs = 20;
+	FIELD per_coord = a, merged = a;
+	auto t1 = high_resolution_clock::now();
+	for (int i = 0; i < n_runs; i++)
+		per_coord.for_each([&b](coord_t c, data_t& v) { v += b.get(c); });
+	auto t2 = high_resolution_clock::now();
+	cout << name << " a += b with get() per coord: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	for (int i = 0; i < n_runs; i++)
+		merged += b;
+	t2 = high_resolution_clock::now();
+	cout << name << " a += b walking both fields: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	for (auto e : merged)
+		assert(fabs(e.second - per_coord[e.first]) < 1e-9);
+}
+
+int main(int argc, char **argv) {
+	srand(15);
+
+	DenseScalarField2 dense_a(9), dense_b(9);
+	fill_random(dense_a, 0.5);
+	fill_random(dense_b, 0.5);
+	check_expressions(dense_a, dense_b, "Dense");
+
+	// Fields are only constructed from expressions with an operand that can have their type
+	static_assert(!FieldExprHasStructure<SparseScalarField2, decltype(dense_a + dense_b)>::value, "no sparse operand");
+	static_assert(FieldExprHasStructure<SparseScalarField2, decltype(dense_a + static_cast<ScalarField2&>(dense_b))>::value, "Field operand");
+	static_assert(FieldExprHasStructure<DenseScalarField2, decltype(-(2. * dense_a))>::value, "dense operand");
+
+	SparseScalarField2 sparse_a(4), sparse_b(4);
+	vector<coord_t> coords = random_sparse_field(sparse_a, 3000, 5, 4);
+	for (size_t i = 0; i < coords.size(); i++)
+		if (i % 3)
+			sparse_b.refineTo(coords[i]);
+	fill_random(sparse_a, 0.5);
+	fill_random(sparse_b, 0.5);
+	SparseScalarField2 sparse_c = sparse_a;
+	fill_random(sparse_c, 0.5);
+	check_expressions(sparse_a, sparse_c, "Sparse, same structure");
+	check_expressions(sparse_a, sparse_b, "Sparse, different structure");
+
+	time_expression(dense_a, dense_b, "Dense ");
+	time_expression(sparse_a, sparse_c, "Sparse");
+	time_merge(sparse_a, sparse_b, "Sparse, different structure");
+	time_merge(sparse_b, sparse_a, "Sparse, different structure (reverse)");
+	time_merge(sparse_b, dense_a, "Sparse + Dense");
+}
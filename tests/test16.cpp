@@ -0,0 +1,93 @@
+#include "includes.hpp"
+
+// TEST16: Field-wide operations with SetThreads() against the same operations on a single thread
+
+// Fill, arithmetic, expressions, convert and merge; the values of the result
+template<typename FIELD, typename SOURCE>
+vector<data_t> run_ops(FIELD& f, SOURCE& source, unsigned threads) {
+	SetThreads(threads);
+	FIELD g = f, h = f;
+	g = 1.5;
+	g *= 3.;
+	g -= f;
+	g += source;
+	h = 2. * g - f / 3. + source * source;
+	h /= 1.25;
+	g.template convert<data_t>(source, [](coord_t c, ScalarField2& s)->data_t { return s.get(c) * c; }, true);
+	h.template merge<data_t>(source, g, [](coord_t c, data_t a, data_t b)->data_t { return a - b; }, true);
+	vector<data_t> result;
+	for (auto e : g)
+		result.push_back(e.second);
+	for (auto e : h)
+		result.push_back(e.second);
+	SetThreads(1);
+	return result;
+}
+
+template<typename FIELD, typename SOURCE>
+void check_threads(FIELD& f, SOURCE& source, const char* name) {
+	fill_random(f);
+	fill_random(source, 1);
+	vector<data_t> serial = run_ops(f, source, 1);
+	for (unsigned threads : {2, 3, 8}) {
+		auto t1 = high_resolution_clock::now();
+		assert(run_ops(f, source, threads) == serial);
+		auto t2 = high_resolution_clock::now();
+		cout << name << " with " << threads << " threads OK in " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	}
+}
+
+// get() of random coords, each thread through its own Accessor, against get() of the field on one thread
+template<typename FIELD>
+void check_accessors(FIELD& f, const char* name) {
+	H2 h2;
+	vector<coord_t> reads;
+	for (int i = 0; i < 100000; i++) {
+		H2::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		reads.push_back(h2.createFromPosition(1 + rand() % 10, pos));
+	}
+	vector<data_t> serial, parallel(reads.size());
+	for (auto c : reads)
+		serial.push_back(f.get(c));
+	const unsigned threads = 4;
+	auto t1 = high_resolution_clock::now();
+	RunThreads(threads, [&](unsigned t) {
+		typename FIELD::Accessor a(f);
+		for (size_t i = reads.size() * t / threads; i < reads.size() * (t + 1) / threads; i++)
+			parallel[i] = a.exists(reads[i]) ? a.getDirect(reads[i]) : a.get(reads[i]);
+	});
+	auto t2 = high_resolution_clock::now();
+	assert(parallel == serial);
+	cout << name << " accessors on " << threads << " threads OK in " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+}
+
+int main(int argc, char **argv) {
+	srand(16);
+	DenseScalarField2 dense(9), dense_source(9);
+	check_threads(dense, dense_source, "Dense, dense source");
+
+	SparseScalarField2 sparse(6), sparse_source(4);
+	vector<coord_t> coords = random_sparse_field(sparse, 4000, 7, 3);
+	for (size_t i = 1; i < coords.size(); i += 2)
+		sparse_source.refineTo(coords[i]);
+	check_threads(sparse, dense_source, "Sparse, dense source");
+	check_threads(sparse, sparse_source, "Sparse, sparse source");
+	DenseScalarField2 dense_small(7);
+	check_threads(dense_small, sparse_source, "Dense, sparse source");
+
+	check_accessors(dense_small, "Dense");
+	check_accessors(sparse, "Sparse");
+
+	// Without asking for it convert() calls its lambda on the calling thread only, whatever SetThreads() says
+	SetThreads(8);
+	set<thread::id> callers;
+	dense.template convert<data_t>(dense_source, [&callers](coord_t c, ScalarField2& s)->data_t {
+		callers.insert(this_thread::get_id());
+		return s.get(c);
+	});
+	assert(callers.size() == 1 && *callers.begin() == this_thread::get_id());
+	SetThreads(1);
+
+	SetThreads(0);
+	cout << "All hardware threads: " << GetThreads() << endl;
+}
@@ -0,0 +1,79 @@
+#include "includes.hpp"
+
+// TEST17: Built-in boundary conditions against the same conditions as boundary lambdas
+
+// Interpolated reads two levels above the field, near the faces many of them hit the boundary
+vector<coord_t> boundary_reads(H3& h3, level_t level) {
+	vector<coord_t> reads;
+	for (int i = 0; i < 200000; i++) {
+		H3::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		pos[i % 3] = (i & 4) ? 0.999 : 0.001;
+		reads.push_back(h3.createFromPosition(level, pos));
+	}
+	return reads;
+}
+
+template<typename FIELD>
+vector<typename FIELD::value_t> read_all(FIELD& f, vector<coord_t>& reads, const char* name) {
+	vector<typename FIELD::value_t> result;
+	result.reserve(reads.size());
+	auto t1 = high_resolution_clock::now();
+	for (auto c : reads)
+		result.push_back(f.get(c));
+	auto t2 = high_resolution_clock::now();
+	cout << name << ": " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	return result;
+}
+
+int main(int argc, char **argv) {
+	H3 h3;
+	srand(17);
+	DenseScalarField3 f(5);
+	fill_random(f);
+	vector<coord_t> reads = boundary_reads(h3, 7);
+
+	// Dirichlet, one value per face
+	DenseScalarField3 lambdas = f;
+	array<data_t, 6> values = {{1, 2, 3, 4, 5, 6}};
+	for (int i = 0; i < 6; i++)
+		lambdas.boundary[i] = [i](ScalarField3 *self, coord_t c)->data_t { return i + 1; };
+	f.setDirichlet(values);
+	assert(read_all(f, reads, "Dirichlet built-in") == read_all(lambdas, reads, "Dirichlet lambda  "));
+
+	// Neumann
+	for (auto& b : lambdas.boundary)
+		b = [](ScalarField3 *self, coord_t c)->data_t { return self->get(self->hcs.removeBoundary(c)); };
+	f.setNeumann();
+	assert(read_all(f, reads, "Neumann built-in  ") == read_all(lambdas, reads, "Neumann lambda    "));
+
+	// Mixed, a lambda takes priority over the built-in condition
+	f.setDirichlet(7., 4);
+	f.boundary[5] = [](ScalarField3 *self, coord_t c)->data_t { return -1; };
+	lambdas.boundary[4] = [](ScalarField3 *self, coord_t c)->data_t { return 7; };
+	lambdas.boundary[5] = f.boundary[5];
+	assert(read_all(f, reads, "Mixed built-in    ") == read_all(lambdas, reads, "Mixed lambda      "));
+
+	// Copies keep the built-in conditions unless boundary_propagate is off
+	f.boundary_propagate[4] = false;
+	DenseScalarField3 g = f;
+	assert(g.boundary_kind[0] == ScalarField3::BC_NEUMANN && g.boundary_kind[4] == ScalarField3::BC_DIRICHLET && g.boundary_value[4] == 0);
+
+	// Reflect negates the normal component of vectors, scalars are reflected like Neumann
+	DenseVectorField3 v(5), v_lambdas(5);
+	for (auto e : v)
+		e.second = Vec3({rand() / (double)RAND_MAX, rand() / (double)RAND_MAX, rand() / (double)RAND_MAX});
+	v_lambdas = v;
+	v.setReflect();
+	for (int i = 0; i < 6; i++)
+		v_lambdas.boundary[i] = [i](VectorField3 *self, coord_t c)->Vec3 {
+			Vec3 inner = self->get(self->hcs.removeBoundary(c));
+			inner[i / 2] = -inner[i / 2];
+			return inner;
+		};
+	vector<Vec3> built_in = read_all(v, reads, "Reflect built-in  "), by_lambda = read_all(v_lambdas, reads, "Reflect lambda    ");
+	for (size_t i = 0; i < reads.size(); i++)
+		assert((built_in[i] - by_lambda[i]).length() == 0);
+	f.setReflect();
+	lambdas.setNeumann();
+	assert(read_all(f, reads, "Reflect scalar    ") == read_all(lambdas, reads, "Neumann scalar    "));
+}
@@ -0,0 +1,69 @@
+#include "includes.hpp"
+
+// TEST18: getMany() against one get() per coord for scattered reads, existing or not
+
+// Probes around random points, a few hundred coords of mixed levels each, in random order
+vector<coord_t> probes(H2& h2, level_t lowest, level_t highest) {
+	vector<coord_t> result;
+	for (int p = 0; p < 100; p++) {
+		H2::pos_t center = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		for (int i = 0; i < 500; i++) {
+			H2::pos_t pos = {center[0] + (rand() / (double)RAND_MAX - 0.5) * 0.05, center[1] + (rand() / (double)RAND_MAX - 0.5) * 0.05};
+			pos[0] = min(max(pos[0], 0.), 0.999999);
+			pos[1] = min(max(pos[1], 0.), 0.999999);
+			result.push_back(h2.createFromPosition(lowest + rand() % (highest - lowest + 1), pos));
+		}
+	}
+	random_shuffle(result.begin(), result.end());
+	return result;
+}
+
+template<typename FIELD>
+void check_get_many(FIELD& f, vector<coord_t>& coords, bool use_non_top, const char* name) {
+	const int n_runs = 1;
+	vector<data_t> single(coords.size()), many(coords.size());
+	auto t1 = high_resolution_clock::now();
+	for (int r = 0; r < n_runs; r++)
+		for (size_t i = 0; i < coords.size(); i++)
+			single[i] = f.get(coords[i], use_non_top);
+	auto t2 = high_resolution_clock::now();
+	cout << name << " get() per coord: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	t1 = high_resolution_clock::now();
+	for (int r = 0; r < n_runs; r++)
+		f.getMany(&coords[0], coords.size(), &many[0], use_non_top);
+	t2 = high_resolution_clock::now();
+	cout << name << " getMany():       " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	assert(single == many);
+
+	// The virtual lookups of Field give the same values
+	Field<data_t, H2>& base = f;
+	fill(many.begin(), many.end(), -1);
+	base.Field<data_t, H2>::getMany(&coords[0], coords.size(), &many[0], use_non_top);
+	assert(single == many);
+}
+
+int main(int argc, char **argv) {
+	H2 h2;
+	srand(18);
+	vector<coord_t> coords = probes(h2, 3, 12);
+
+	DenseScalarField2 dense(8);
+	fill_random(dense);
+	dense.setNeumann(0);
+	check_get_many(dense, coords, true, "Dense ");
+
+	SparseScalarField2 sparse(5);
+	random_sparse_field(sparse, 5000, 6, 4);
+	fill_random(sparse);
+	sparse.propagate();
+	check_get_many(sparse, coords, true, "Sparse");
+	check_get_many(sparse, coords, false, "Sparse, top only");
+
+	// Through an Accessor, and for an empty request
+	vector<data_t> results(coords.size());
+	SparseScalarField2::Accessor a(sparse);
+	a.getMany(&coords[0], coords.size(), &results[0]);
+	for (size_t i = 0; i < coords.size(); i++)
+		assert(results[i] == sparse.get(coords[i]));
+	sparse.getMany(NULL, 0, NULL);
+}
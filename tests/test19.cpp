@@ -0,0 +1,103 @@
+#include "includes.hpp"
+
+// TEST19: propagateDirty() after local changes against a full propagate()
+
+// Changes the top-level values in a small patch around pos and marks them, a copy gets the same values unmarked
+template<typename FIELD>
+void change_patch(FIELD& f, FIELD& reference, H2::pos_t pos) {
+	level_t level = f.getHighestLevel();
+	coord_t center = f.hcs.createFromPosition(level, pos);
+	for (int i = 0; i < 40; i++) {
+		coord_t c = center;
+		for (int step = 0; step < 4; step++) {
+			coord_t n = f.hcs.getNeighbor(c, rand() % 4);
+			if (!f.hcs.IsBoundary(n))
+				c = n;
+		}
+		while (!f.exists(c))
+			c = f.hcs.ReduceLevel(c);
+		if (!f.isTop(c))
+			continue;
+		data_t value = rand() / (double)RAND_MAX;
+		f[c] = reference[c] = value;
+		f.markDirty(c);
+	}
+}
+
+template<typename FIELD>
+void check_dirty(FIELD& f, const char* name) {
+	fill_random(f);
+	f.propagate();
+	FIELD reference = f;
+	const int n_runs = 50;
+	long long full = 0, dirty = 0;
+	for (int r = 0; r < n_runs; r++) {
+		H2::pos_t pos = {rand() / (double)RAND_MAX, rand() / (double)RAND_MAX};
+		change_patch(f, reference, pos);
+		if (r % 2)
+			change_patch(f, reference, {1 - pos[0], pos[1]});
+		auto t1 = high_resolution_clock::now();
+		reference.propagate();
+		auto t2 = high_resolution_clock::now();
+		if (r % 5 == 4)
+			static_cast<Field<data_t, H2>&>(f).propagateDirty();
+		else
+			f.propagateDirty();
+		auto t3 = high_resolution_clock::now();
+		full += duration_cast<microseconds>(t2 - t1).count();
+		dirty += duration_cast<microseconds>(t3 - t2).count();
+		for (auto e : reference)
+			assert(f.getDirect(e.first) == e.second);
+	}
+	cout << name << " propagate(): " << full << "us, propagateDirty(): " << dirty << "us.\n";
+
+	// A full propagate() clears the marks
+	coord_t c = f.hcs.createFromPosition(f.getHighestLevel(), {0.5, 0.5});
+	while (!f.exists(c))
+		c = f.hcs.ReduceLevel(c);
+	f.markDirty(c);
+	f.propagate();
+	f.propagateDirty();
+	for (auto e : reference)
+		assert(f.getDirect(e.first) == e.second);
+
+	// Copies, constructed or assigned, take the marks of their source
+	f[c] += 1;
+	reference[c] = f[c];
+	f.markDirty(c);
+	FIELD constructed = f, assigned = reference;
+	assigned = f;
+	reference.propagate();
+	constructed.propagateDirty();
+	assigned.propagateDirty();
+	for (auto e : reference)
+		assert(constructed.getDirect(e.first) == e.second && assigned.getDirect(e.first) == e.second);
+}
+
+int main(int argc, char **argv) {
+	H2 h2;
+	srand(19);
+	DenseScalarField2 dense(9);
+	check_dirty(dense, "Dense ");
+
+	SparseScalarField2 sparse(5);
+	random_sparse_field(sparse, 8000, 6, 4);
+	check_dirty(sparse, "Sparse");
+
+	// Marks survive changes of the bucket layout
+	SparseScalarField2 refined = sparse;
+	refined.propagate();
+	coord_t c = h2.createFromPosition(9, {0.3, 0.6});
+	refined.refineTo(c);
+	refined.propagate();
+	SparseScalarField2 reference = refined;
+	refined[c] = reference[c] = 5;
+	refined.markDirty(c);
+	refined.coarse(h2.ReduceLevel(h2.ReduceLevel(h2.createFromPosition(9, {0.7, 0.2}))));
+	reference.coarse(h2.ReduceLevel(h2.ReduceLevel(h2.createFromPosition(9, {0.7, 0.2}))));
+	refined.propagateDirty();
+	reference.propagate();
+	for (auto e : reference)
+		assert(refined.getDirect(e.first) == e.second);
+	cout << "Marks across refineTo() and coarse() OK.\n";
+}
@@ -0,0 +1,131 @@
+#include "includes.hpp"
+
+// TEST20: Reductions (sum, dot, norm2, min, max, minmax) against loops over the iterator, and the same bits for any
+// number of threads
+
+// All reductions of a and b, a and b with the same structure
+template<typename FIELD>
+vector<data_t> reduce_all(FIELD& a, FIELD& b, bool top_only) {
+	auto range = minmax(a, top_only);
+	return {sum(a, top_only), dot(a, b, top_only), norm2(a, top_only), min(a, top_only), max(a, top_only), range.first, range.second};
+}
+
+template<typename FIELD>
+void check_reductions(FIELD& a, FIELD& b, bool top_only, const char* name) {
+	data_t s = 0, d = 0, n = 0, lo = numeric_limits<data_t>::infinity(), hi = -lo;
+	for (auto it = a.begin(top_only); it != a.end(); ++it) {
+		data_t v = (*it).second;
+		s += v;
+		d += v * b[(*it).first];
+		n += v * v;
+		lo = min(lo, v);
+		hi = max(hi, v);
+	}
+	vector<data_t> serial = reduce_all(a, b, top_only);
+	data_t tolerance = 1e-12 * a.nElements();
+	assert(fabs(serial[0] - s) < tolerance && fabs(serial[1] - d) < tolerance && fabs(serial[2] - sqrt(n)) < tolerance);
+	assert(serial[3] == lo && serial[4] == hi && serial[5] == lo && serial[6] == hi);
+	for (unsigned threads : {2, 3, 8}) {
+		SetThreads(threads);
+		assert(reduce_all(a, b, top_only) == serial);
+	}
+	SetThreads(1);
+	cout << name << (top_only ? ", top only" : "") << ": sum " << serial[0] << " dot " << serial[1] << " norm2 " << serial[2] << " OK.\n";
+}
+
+// dot() of fields of different structure against get() per coord of a
+template<typename FIELD, typename FIELD2>
+void check_dot(FIELD& a, FIELD2& b, const char* name) {
+	for (bool top_only : {false, true}) {
+		data_t d = 0;
+		for (auto it = a.begin(top_only); it != a.end(); ++it)
+			d += (*it).second * b.get((*it).first);
+		data_t serial = dot(a, b, top_only);
+		assert(fabs(serial - d) < 1e-12 * a.nElements());
+		for (unsigned threads : {2, 3, 8}) {
+			SetThreads(threads);
+			assert(dot(a, b, top_only) == serial);
+		}
+		SetThreads(1);
+	}
+	cout << name << ": dot " << dot(a, b) << " OK.\n";
+}
+
+// dot() as in the solvers before, with the iterator and b[] per coord, against dot()
+template<typename FIELD>
+void time_dot(FIELD& a, FIELD& b, const char* name) {
+	const int n_runs = 20;
+	data_t d_iter = 0, d_reduce = 0;
+	auto t1 = high_resolution_clock::now();
+	for (int i = 0; i < n_runs; i++)
+		for (auto e : a)
+			d_iter += e.second * b[e.first];
+	auto t2 = high_resolution_clock::now();
+	cout << name << " dot with iterator and b[]: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	for (unsigned threads : {1, 4}) {
+		SetThreads(threads);
+		d_reduce = 0;
+		t1 = high_resolution_clock::now();
+		for (int i = 0; i < n_runs; i++)
+			d_reduce += dot(a, b);
+		t2 = high_resolution_clock::now();
+		cout << name << " dot() on " << threads << " threads: " << duration_cast<milliseconds>(t2 - t1).count() << "ms.\n";
+	}
+	SetThreads(1);
+	assert(fabs(d_iter - d_reduce) < 1e-12 * n_runs * a.nElements());
+}
+
+int main(int argc, char **argv) {
+	H2 h2;
+	srand(20);
+
+	DenseScalarField2 dense_a(10), dense_b(10);
+	fill_random(dense_a, -0.25);
+	fill_random(dense_b, -0.25);
+	check_reductions(dense_a, dense_b, false, "Dense");
+	check_reductions(dense_a, dense_b, true, "Dense");
+
+	SparseScalarField2 sparse_a(5), sparse_other(5);
+	vector<coord_t> coords = random_sparse_field(sparse_a, 20000, 6, 4);
+	for (size_t i = 1; i < coords.size(); i += 2)
+		sparse_other.refineTo(coords[i]);
+	SparseScalarField2 sparse_b = sparse_a;
+	fill_random(sparse_a, -0.25);
+	fill_random(sparse_b, -0.25);
+	check_reductions(sparse_a, sparse_b, false, "Sparse");
+	check_reductions(sparse_a, sparse_b, true, "Sparse");
+
+	// Through the base class, as the solvers use them
+	ScalarField2& base = sparse_a;
+	assert(sum(base) == sum(sparse_a) && sum(base, true) == sum(sparse_a, true));
+
+	// Empty fields give the neutral values
+	DenseScalarField2 empty;
+	assert(sum(empty) == 0 && min(empty) == numeric_limits<data_t>::infinity() && max(empty) == -numeric_limits<data_t>::infinity());
+
+	// Same coords in other buckets: a level-5 field against a level-4 field refined to all level-5 coords
+	SparseScalarField2 same_a(5), same_b(4);
+	for (coord_t c = h2.CreateMinLevel(5); c <= h2.CreateMaxLevel(5); c++)
+		same_b.refineTo(c);
+	vector<coord_t> coords_a, coords_b;
+	for (auto e : same_a)
+		coords_a.push_back(e.first);
+	for (auto e : same_b)
+		coords_b.push_back(e.first);
+	sort(coords_a.begin(), coords_a.end());		// the iterator walks bucket by bucket
+	sort(coords_b.begin(), coords_b.end());
+	assert(coords_a == coords_b && same_a.levels().size() != same_b.levels().size());
+	fill_random(same_a, -0.25);
+	fill_random(same_b, -0.25);
+	check_dot(same_a, same_b, "Same coords, other buckets");
+	check_dot(same_b, same_a, "Same coords, other buckets (reverse)");
+
+	// Coords b lacks are interpolated
+	fill_random(sparse_other, -0.25);
+	check_dot(sparse_a, sparse_other, "Sparse, fewer coords");
+	check_dot(sparse_other, sparse_a, "Sparse, more coords");
+	check_dot(sparse_a, dense_a, "Sparse, dense");
+
+	time_dot(dense_a, dense_b, "Dense ");
+	time_dot(sparse_a, sparse_b, "Sparse");
+}
@@ -78,8 +78,9 @@ int main(int argc, char **argv) {
 	// BC 0 = BC 1 = reflect (X+ X-
 	// BC 3 = 0 (default) (Y+)
 	// BC 2 = 1 (Y-)
-	u.boundary[2] = [](ScalarField2 *self, coord_t cc)->data_t { return 1;};
-	u.boundary[0] = u.boundary[1] = [](ScalarField2 *self, coord_t cc)->data_t { coord_t c = self->hcs.removeBoundary(cc); return self->get(c);};
+	u.setDirichlet(1., 2);
+	u.setNeumann(0);
+	u.setNeumann(1);
 
 	write_pgm("test31.pgm", u, 10);
 	write_pgm_level("test32.pgm", u);
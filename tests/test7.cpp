@@ -67,10 +67,7 @@ int main(int argc, char **argv) {
 	}
 
 	// make v stress-free at all boundaries
-	for (auto &boundary : v.boundary)
-		boundary = [](VectorFieldBase *self, coord_t c)->Vec {
-			return self->get(self->hcs.removeBoundary(c)); // Neumann BC, derivative == 0
-		};
+	v.setNeumann();	// derivative == 0
 
 	write_pgm("c_init.pgm", c, c_level);
 //return 0;
@@ -50,12 +50,12 @@ void poisson2(DenseScalarField1 &x, DenseScalarField1 &b) {
     for (auto element : x)
         if (!x.isTop(element.first))
             element.second = 0;
-    for (level_t level = x.getHighestLevel(); level > 0; level--) {
-        for (auto it = x.begin(false, level); it != x.end(); ++it) {
-            const coord_t &coord = (*it).first;
-            data_t dist = 1. / pow(2, level);
+    for (auto& span : x.levels(1, -1, true)) {
+        for (size_t i = 0; i < span.size(); i++) {
+            const coord_t coord = span.coord(i);
+            data_t dist = 1. / pow(2, span.level);
             data_t volume = dist * dist;
-            data_t value = (*it).second;// * volume;
+            data_t value = span[i];// * volume;
             //Vec2 grad = grad_x[coord];
 
             auto coeffs = hcs.getCoeffs(coord);
@@ -76,13 +76,13 @@ void poisson2(DenseScalarField1 &x, DenseScalarField1 &b) {
     //    err_return = 0;
     //    err_b = 0;
     // Up
-    for (level_t level = 1; level <= x.getHighestLevel(); level++) {
+    for (auto& span : x.levels(1)) {
 		// Up propagation of x
-		for (auto it = x.begin(false, level); it != x.end(); ++it) {
-            data_t dist = 1. / pow(2, level);
+		for (size_t i = 0; i < span.size(); i++) {
+            data_t dist = 1. / pow(2, span.level);
             data_t volume = dist * dist;
-			const coord_t &coord = (*it).first;
-			data_t &value = (*it).second;
+			const coord_t coord = span.coord(i);
+			data_t &value = span[i];
 			auto coeffs = hcs.getCoeffs(coord);
 			data_t v = 0;
 			for (auto coeff : coeffs) {